@@ -0,0 +1,315 @@
+#include <string.h>
+#include <stddef.h>
+#include "blake3.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// BLAKE3 명세의 이식 가능한(portable) 구현이다. 해시 상태는 한 번에 블록 하나씩 압축한다.
+// 여러 청크를 병렬로 압축하는 공식 구현의 SIMD 경로는 1KiB를 넘는 입력에서만 쓰이므로 옮기지 않았다.
+// 대신 탐색처럼 짧은 입력 여러 개를 해시하는 경우를 위해, 입력마다 SIMD 레인 하나를 쓰는 blake3_compress_lanes를 둔다.
+
+static const uint32_t IV[8] = {
+  0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+// 라운드마다 메시지 워드를 섞는 순서를 미리 전개한 표
+static const uint8_t MSG_SCHEDULE[7][16] = {
+  { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+  { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+  { 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+  { 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+  { 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+  { 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+  { 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 },
+};
+
+// 압축 결과를 만들기 위한 입력. 루트 출력은 BLAKE3_ROOT 플래그를 더해 같은 입력을 다시 압축한다.
+typedef struct {
+  uint32_t cv[8];
+  uint32_t block[16];
+  uint64_t counter;
+  uint32_t blockLen;
+  uint32_t flags;
+} Output;
+
+static inline uint32_t rotr(uint32_t value, int shift)
+{
+  return (value >> shift) | (value << (32 - shift));
+}
+
+static inline uint32_t load32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void g(uint32_t* s, int a, int b, int c, int d, uint32_t mx, uint32_t my)
+{
+  s[a] = s[a] + s[b] + mx;
+  s[d] = rotr(s[d] ^ s[a], 16);
+  s[c] = s[c] + s[d];
+  s[b] = rotr(s[b] ^ s[c], 12);
+  s[a] = s[a] + s[b] + my;
+  s[d] = rotr(s[d] ^ s[a], 8);
+  s[c] = s[c] + s[d];
+  s[b] = rotr(s[b] ^ s[c], 7);
+}
+
+/**
+ * @brief 압축 함수. 16워드 결과를 모두 계산하며, 연쇄값으로는 앞의 8워드를 사용한다.
+ */
+static void compress(const uint32_t cv[8], const uint32_t block[16], uint64_t counter, uint32_t blockLen, uint32_t flags, uint32_t out[16])
+{
+  uint32_t s[16] = {
+    cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+    IV[0], IV[1], IV[2], IV[3], (uint32_t)counter, (uint32_t)(counter >> 32), blockLen, flags,
+  };
+
+  for (int r = 0; r < 7; r++) {
+    const uint8_t* m = MSG_SCHEDULE[r];
+    g(s, 0, 4, 8, 12, block[m[0]], block[m[1]]);
+    g(s, 1, 5, 9, 13, block[m[2]], block[m[3]]);
+    g(s, 2, 6, 10, 14, block[m[4]], block[m[5]]);
+    g(s, 3, 7, 11, 15, block[m[6]], block[m[7]]);
+    g(s, 0, 5, 10, 15, block[m[8]], block[m[9]]);
+    g(s, 1, 6, 11, 12, block[m[10]], block[m[11]]);
+    g(s, 2, 7, 8, 13, block[m[12]], block[m[13]]);
+    g(s, 3, 4, 9, 14, block[m[14]], block[m[15]]);
+  }
+
+  for (int i = 0; i < 8; i++) {
+    out[i] = s[i] ^ s[i + 8];
+    out[i + 8] = s[i + 8] ^ cv[i];
+  }
+}
+
+static void loadBlock(const uint8_t bytes[BLAKE3_BLOCK_LEN], uint32_t block[16])
+{
+  for (int i = 0; i < 16; i++) {
+    block[i] = load32(bytes + i * 4);
+  }
+}
+
+static void outputChainingValue(const Output* output, uint32_t cv[8])
+{
+  uint32_t out[16];
+  compress(output->cv, output->block, output->counter, output->blockLen, output->flags, out);
+  memcpy(cv, out, 8 * sizeof(uint32_t));
+}
+
+static void chunkInit(blake3_chunk_state* chunk, const uint32_t key[8], uint64_t chunkCounter, uint32_t flags)
+{
+  memcpy(chunk->cv, key, sizeof(chunk->cv));
+  chunk->chunkCounter = chunkCounter;
+  memset(chunk->block, 0, sizeof(chunk->block));
+  chunk->blockLen = 0;
+  chunk->blocksCompressed = 0;
+  chunk->flags = flags;
+}
+
+static size_t chunkLen(const blake3_chunk_state* chunk)
+{
+  return (size_t)BLAKE3_BLOCK_LEN * chunk->blocksCompressed + chunk->blockLen;
+}
+
+static uint32_t chunkStartFlag(const blake3_chunk_state* chunk)
+{
+  return chunk->blocksCompressed == 0 ? BLAKE3_CHUNK_START : 0;
+}
+
+static void chunkUpdate(blake3_chunk_state* chunk, const uint8_t* input, size_t length)
+{
+  while (length > 0) {
+    // 블록이 가득 찼고 입력이 더 남았을 때만 압축한다. 마지막 블록은 BLAKE3_CHUNK_END와 함께 압축해야 하기 때문이다.
+    if (chunk->blockLen == BLAKE3_BLOCK_LEN) {
+      uint32_t block[16], out[16];
+      loadBlock(chunk->block, block);
+      compress(chunk->cv, block, chunk->chunkCounter, BLAKE3_BLOCK_LEN, chunk->flags | chunkStartFlag(chunk), out);
+      memcpy(chunk->cv, out, sizeof(chunk->cv));
+      chunk->blocksCompressed++;
+      memset(chunk->block, 0, sizeof(chunk->block));
+      chunk->blockLen = 0;
+    }
+
+    size_t take = BLAKE3_BLOCK_LEN - chunk->blockLen;
+    if (take > length) {
+      take = length;
+    }
+    memcpy(chunk->block + chunk->blockLen, input, take);
+    chunk->blockLen += take;
+    input += take;
+    length -= take;
+  }
+}
+
+static void chunkOutput(const blake3_chunk_state* chunk, Output* output)
+{
+  memcpy(output->cv, chunk->cv, sizeof(output->cv));
+  loadBlock(chunk->block, output->block);
+  output->counter = chunk->chunkCounter;
+  output->blockLen = chunk->blockLen;
+  output->flags = chunk->flags | chunkStartFlag(chunk) | BLAKE3_CHUNK_END;
+}
+
+static void parentOutput(const uint32_t left[8], const uint32_t right[8], const uint32_t key[8], uint32_t flags, Output* output)
+{
+  memcpy(output->cv, key, sizeof(output->cv));
+  memcpy(output->block, left, 8 * sizeof(uint32_t));
+  memcpy(output->block + 8, right, 8 * sizeof(uint32_t));
+  output->counter = 0;
+  output->blockLen = BLAKE3_BLOCK_LEN;
+  output->flags = BLAKE3_PARENT | flags;
+}
+
+/**
+ * @brief 완성된 청크의 연쇄값을 스택에 넣는 함수이다.
+ * 지금까지의 청크 수에서 끝자리 0 비트마다 완성된 부분 트리가 하나씩 생기므로 그만큼 부모 노드로 합친다.
+ */
+static void pushChunkCv(blake3_hasher* hasher, uint32_t cv[8], uint64_t totalChunks)
+{
+  while ((totalChunks & 1) == 0) {
+    Output parent;
+    hasher->cvStackLen--;
+    parentOutput(hasher->cvStack[hasher->cvStackLen], cv, hasher->key, hasher->flags, &parent);
+    outputChainingValue(&parent, cv);
+    totalChunks >>= 1;
+  }
+  memcpy(hasher->cvStack[hasher->cvStackLen], cv, 8 * sizeof(uint32_t));
+  hasher->cvStackLen++;
+}
+
+void blake3_hasher_init(blake3_hasher* hasher)
+{
+  memcpy(hasher->key, IV, sizeof(hasher->key));
+  hasher->flags = 0;
+  hasher->cvStackLen = 0;
+  chunkInit(&hasher->chunk, hasher->key, 0, 0);
+}
+
+void blake3_hasher_update(blake3_hasher* hasher, const void* input, size_t length)
+{
+  const uint8_t* bytes = (const uint8_t*)input;
+  while (length > 0) {
+    // 청크가 가득 찼고 입력이 더 남았을 때만 청크를 끝낸다. 마지막 청크는 루트일 수 있기 때문이다.
+    if (chunkLen(&hasher->chunk) == BLAKE3_CHUNK_LEN) {
+      Output output;
+      uint32_t cv[8];
+      chunkOutput(&hasher->chunk, &output);
+      outputChainingValue(&output, cv);
+      uint64_t totalChunks = hasher->chunk.chunkCounter + 1;
+      pushChunkCv(hasher, cv, totalChunks);
+      chunkInit(&hasher->chunk, hasher->key, totalChunks, hasher->flags);
+    }
+
+    size_t take = BLAKE3_CHUNK_LEN - chunkLen(&hasher->chunk);
+    if (take > length) {
+      take = length;
+    }
+    chunkUpdate(&hasher->chunk, bytes, take);
+    bytes += take;
+    length -= take;
+  }
+}
+
+void blake3_hasher_finalize(const blake3_hasher* hasher, uint8_t out[BLAKE3_OUT_LEN])
+{
+  Output output;
+  uint32_t cv[8];
+  uint32_t words[16];
+
+  // 현재 청크의 출력에서 시작하여 스택의 연쇄값들과 오른쪽부터 합친다.
+  chunkOutput(&hasher->chunk, &output);
+  for (int i = hasher->cvStackLen; i > 0; i--) {
+    outputChainingValue(&output, cv);
+    parentOutput(hasher->cvStack[i - 1], cv, hasher->key, hasher->flags, &output);
+  }
+
+  compress(output.cv, output.block, 0, output.blockLen, output.flags | BLAKE3_ROOT, words);
+  for (int i = 0; i < BLAKE3_OUT_LEN / 4; i++) {
+    out[i * 4] = (uint8_t)words[i];
+    out[i * 4 + 1] = (uint8_t)(words[i] >> 8);
+    out[i * 4 + 2] = (uint8_t)(words[i] >> 16);
+    out[i * 4 + 3] = (uint8_t)(words[i] >> 24);
+  }
+}
+
+void blake3_hasher_copy(blake3_hasher* dest, const blake3_hasher* src)
+{
+  memcpy(dest, src, offsetof(blake3_hasher, cvStack) + src->cvStackLen * sizeof(src->cvStack[0]));
+}
+
+#ifdef __SSE2__
+static inline __m128i rotrLanes(__m128i value, int shift)
+{
+  return _mm_or_si128(_mm_srli_epi32(value, shift), _mm_slli_epi32(value, 32 - shift));
+}
+
+static inline void gLanes(__m128i* s, int a, int b, int c, int d, __m128i mx, __m128i my)
+{
+  s[a] = _mm_add_epi32(_mm_add_epi32(s[a], s[b]), mx);
+  s[d] = rotrLanes(_mm_xor_si128(s[d], s[a]), 16);
+  s[c] = _mm_add_epi32(s[c], s[d]);
+  s[b] = rotrLanes(_mm_xor_si128(s[b], s[c]), 12);
+  s[a] = _mm_add_epi32(_mm_add_epi32(s[a], s[b]), my);
+  s[d] = rotrLanes(_mm_xor_si128(s[d], s[a]), 8);
+  s[c] = _mm_add_epi32(s[c], s[d]);
+  s[b] = rotrLanes(_mm_xor_si128(s[b], s[c]), 7);
+}
+
+/**
+ * @brief SSE2 레지스터의 32비트 워드 4개를 레인으로 써서 compress와 같은 라운드를 4개 입력에 동시에 적용한다.
+ * [워드][레인] 배열은 워드 하나가 레지스터 하나에 그대로 올라가므로 전치가 필요 없다.
+ */
+void blake3_compress_lanes(uint32_t cv[8][BLAKE3_LANES], const uint32_t block[16][BLAKE3_LANES], uint64_t counter, uint32_t blockLen, uint32_t flags)
+{
+  __m128i s[16], m[16];
+  for (int i = 0; i < 8; i++) {
+    s[i] = _mm_loadu_si128((const __m128i*)cv[i]);
+    s[i + 8] = i < 4 ? _mm_set1_epi32((int)IV[i]) : _mm_setzero_si128();
+  }
+  s[12] = _mm_set1_epi32((int)(uint32_t)counter);
+  s[13] = _mm_set1_epi32((int)(uint32_t)(counter >> 32));
+  s[14] = _mm_set1_epi32((int)blockLen);
+  s[15] = _mm_set1_epi32((int)flags);
+  for (int i = 0; i < 16; i++) {
+    m[i] = _mm_loadu_si128((const __m128i*)block[i]);
+  }
+
+  for (int r = 0; r < 7; r++) {
+    const uint8_t* x = MSG_SCHEDULE[r];
+    gLanes(s, 0, 4, 8, 12, m[x[0]], m[x[1]]);
+    gLanes(s, 1, 5, 9, 13, m[x[2]], m[x[3]]);
+    gLanes(s, 2, 6, 10, 14, m[x[4]], m[x[5]]);
+    gLanes(s, 3, 7, 11, 15, m[x[6]], m[x[7]]);
+    gLanes(s, 0, 5, 10, 15, m[x[8]], m[x[9]]);
+    gLanes(s, 1, 6, 11, 12, m[x[10]], m[x[11]]);
+    gLanes(s, 2, 7, 8, 13, m[x[12]], m[x[13]]);
+    gLanes(s, 3, 4, 9, 14, m[x[14]], m[x[15]]);
+  }
+
+  for (int i = 0; i < 8; i++) {
+    _mm_storeu_si128((__m128i*)cv[i], _mm_xor_si128(s[i], s[i + 8]));
+  }
+}
+#else
+/**
+ * @brief SSE2가 없는 환경에서는 레인마다 compress를 차례로 호출한다.
+ */
+void blake3_compress_lanes(uint32_t cv[8][BLAKE3_LANES], const uint32_t block[16][BLAKE3_LANES], uint64_t counter, uint32_t blockLen, uint32_t flags)
+{
+  for (int lane = 0; lane < BLAKE3_LANES; lane++) {
+    uint32_t laneCv[8], laneBlock[16], out[16];
+    for (int i = 0; i < 8; i++) {
+      laneCv[i] = cv[i][lane];
+    }
+    for (int i = 0; i < 16; i++) {
+      laneBlock[i] = block[i][lane];
+    }
+    compress(laneCv, laneBlock, counter, blockLen, flags, out);
+    for (int i = 0; i < 8; i++) {
+      cv[i][lane] = out[i];
+    }
+  }
+}
+#endif
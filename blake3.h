@@ -0,0 +1,60 @@
+#ifndef BLAKE3_H
+#define BLAKE3_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLAKE3_OUT_LEN 32     // 해시 출력 길이
+#define BLAKE3_BLOCK_LEN 64   // 압축 함수 블록 길이
+#define BLAKE3_CHUNK_LEN 1024 // 청크 길이
+#define BLAKE3_MAX_DEPTH 54   // 청크 연쇄값(chaining value) 스택의 최대 깊이
+#define BLAKE3_LANES 4        // blake3_compress_lanes가 동시에 압축하는 입력 수 (SSE2 레지스터 하나의 32비트 워드 수)
+
+// 압축 함수의 도메인 플래그
+#define BLAKE3_CHUNK_START (1 << 0)
+#define BLAKE3_CHUNK_END (1 << 1)
+#define BLAKE3_PARENT (1 << 2)
+#define BLAKE3_ROOT (1 << 3)
+
+// 현재 청크의 상태
+typedef struct _Blake3_Chunk_State {
+  uint32_t cv[8];             // 청크의 연쇄값
+  uint64_t chunkCounter;      // 청크 번호
+  uint8_t block[BLAKE3_BLOCK_LEN];  // 아직 압축하지 않은 블록
+  uint8_t blockLen;
+  uint8_t blocksCompressed;   // 청크 안에서 압축한 블록 수
+  uint32_t flags;
+} blake3_chunk_state;
+
+// BLAKE3 해시 상태. 포인터가 없으므로 구조체를 복사하여 상태를 복제할 수 있다.
+// 스택은 사용하는 깊이만큼만 복사하면 되도록 마지막에 둔다.
+typedef struct _Blake3_Hasher {
+  blake3_chunk_state chunk;
+  uint32_t key[8];
+  uint32_t flags;
+  uint8_t cvStackLen;
+  uint32_t cvStack[BLAKE3_MAX_DEPTH][8];
+} blake3_hasher;
+
+/// @brief 해시 상태를 초기화한다
+void blake3_hasher_init(blake3_hasher* hasher);
+
+/// @brief 입력을 해시 상태에 반영한다
+void blake3_hasher_update(blake3_hasher* hasher, const void* input, size_t length);
+
+/// @brief 해시 상태를 바꾸지 않고 32바이트 해시값을 계산한다
+void blake3_hasher_finalize(const blake3_hasher* hasher, uint8_t out[BLAKE3_OUT_LEN]);
+
+/// @brief 해시 상태를 복제한다. 스택은 사용 중인 깊이만 복사한다
+void blake3_hasher_copy(blake3_hasher* dest, const blake3_hasher* src);
+
+/// @brief 입력 BLAKE3_LANES개를 레인마다 하나씩 동시에 압축한다. 배열은 [워드][레인] 순서이다
+/// 모든 레인이 같은 카운터, 블록 길이, 플래그를 쓰는 경우(같은 길이의 짧은 입력들)에 쓴다.
+/// @param cv 레인별 연쇄값. 압축 결과의 앞 8워드로 바뀌며, BLAKE3_ROOT 플래그를 주면 레인별 해시값이 된다
+/// @param block 레인별 메시지 블록 (리틀 엔디언 워드)
+/// @param counter 청크 번호
+/// @param blockLen 블록 길이
+/// @param flags 도메인 플래그 (BLAKE3_*)
+void blake3_compress_lanes(uint32_t cv[8][BLAKE3_LANES], const uint32_t block[16][BLAKE3_LANES], uint64_t counter, uint32_t blockLen, uint32_t flags);
+
+#endif
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "proof_of_work.h"
+#include "blake3_kernels.h"
+
+// 범용 탐색 경로는 nonce마다 BLAKE3 해시 상태를 복사하여 nonce 문자열을 더하고 마무리한다.
+// 레인 커널은 챌린지와 nonce가 첫 청크 안에 들어가는 경우에만 쓰며, 이때 루트는 nonce가 든 마지막 블록이다.
+// 범위를 시작할 때 챌린지 꼬리와 nonce 자리를 블록에 한 번만 채워 두고, 연속한 nonce BLAKE3_LANES개의
+// 블록을 레인마다 만들어 nonce가 든 블록만 동시에 압축한다. 난이도는 해시 워드에서 직접 비교한다.
+
+#define CANCEL_CHECK_MASK 0xFF  // 중단 플래그를 확인하는 주기 (nonce 수 - 1). BLAKE3_LANES의 배수여야 한다
+#define MAX_DIGITS 10           // unsigned int nonce의 최대 10진수 자릿수
+
+static inline uint32_t load32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline bool isCancelled(const volatile bool* cancel)
+{
+  return terminateFindNonce || (cancel != NULL && *cancel);
+}
+
+static inline bool meetsDifficulty(const blake3_kernel_job* job, const uint32_t h[8])
+{
+  for (int i = 0; i < job->zeroWords; i++) {
+    if (h[i] != 0) {
+      return false;
+    }
+  }
+  return job->zeroMask == 0 || (h[job->zeroWords] & job->zeroMask) == 0;
+}
+
+static void toHexString(const uint32_t h[8], char hashresult[65])
+{
+  for (int i = 0; i < 8; i++) {
+    sprintf(hashresult + i * 8, "%08x", h[i]);
+  }
+  hashresult[64] = '\0';
+}
+
+/**
+ * @brief nonce 자릿수(digits)가 모두 같은 범위 [start, start + count)를 탐색하는 함수이다.
+ * 블록 안의 10진수 nonce는 끝자리부터 올림하며 증가시키고, nonce가 걸친 워드만 레인마다 다시 읽는다.
+ */
+static int searchDigits(const blake3_kernel_job* job, int digits, unsigned int start, unsigned int count,
+    unsigned int* nonce, char hashresult[65], const volatile bool* cancel)
+{
+  uint8_t bytes[2 * BLAKE3_BLOCK_LEN];
+  uint32_t block[32][BLAKE3_LANES];
+  uint32_t cv[8][BLAKE3_LANES];
+  uint8_t* text = bytes + job->tailLength;
+  unsigned int length = job->tailLength + digits;
+  int blocks = length > BLAKE3_BLOCK_LEN ? 2 : 1;
+  int firstWord = job->tailLength / 4;
+  int lastWord = (length - 1) / 4;
+
+  memset(bytes, 0, sizeof(bytes));
+  memcpy(bytes, job->tail, job->tailLength);
+  unsigned int value = start;
+  for (int i = digits - 1; i >= 0; i--) {
+    text[i] = '0' + value % 10;
+    value /= 10;
+  }
+  for (int i = 0; i < blocks * 16; i++) {
+    uint32_t word = load32(bytes + i * 4);
+    for (int lane = 0; lane < BLAKE3_LANES; lane++) {
+      block[i][lane] = word;
+    }
+  }
+
+  for (unsigned int i = 0; i < count; i += BLAKE3_LANES) {
+    if ((i & CANCEL_CHECK_MASK) == 0 && isCancelled(cancel)) {
+      return POW_TERMINATED;
+    }
+    // 연속한 nonce를 레인마다 채운다. 남은 nonce가 레인 수보다 적으면 뒤쪽 레인의 결과는 보지 않는다.
+    for (int lane = 0; lane < BLAKE3_LANES; lane++) {
+      for (int w = firstWord; w <= lastWord; w++) {
+        block[w][lane] = load32(bytes + w * 4);
+      }
+      for (int j = digits - 1; j >= 0; j--) {
+        if (text[j] != '9') {
+          text[j]++;
+          break;
+        }
+        text[j] = '0';
+      }
+    }
+
+    memcpy(cv, job->cv, sizeof(cv));
+    if (blocks == 2) {
+      blake3_compress_lanes(cv, block, 0, BLAKE3_BLOCK_LEN, job->flags);
+      blake3_compress_lanes(cv, block + 16, 0, length - BLAKE3_BLOCK_LEN,
+        (job->flags & ~BLAKE3_CHUNK_START) | BLAKE3_CHUNK_END | BLAKE3_ROOT);
+    }
+    else {
+      blake3_compress_lanes(cv, block, 0, length, job->flags | BLAKE3_CHUNK_END | BLAKE3_ROOT);
+    }
+
+    // 해시값은 리틀 엔디언 워드이므로, 뒤집어 읽으면 16진수 문자열과 같은 순서가 된다.
+    unsigned int lanes = count - i < BLAKE3_LANES ? count - i : BLAKE3_LANES;
+    for (unsigned int lane = 0; lane < lanes; lane++) {
+      uint32_t h[8];
+      for (int w = 0; w < 8; w++) {
+        h[w] = __builtin_bswap32(cv[w][lane]);
+      }
+      if (meetsDifficulty(job, h)) {
+        *nonce = start + i + lane;
+        toHexString(h, hashresult);
+        return POW_SUCCESS;
+      }
+    }
+  }
+  return POW_NOTFOUND;
+}
+
+bool blake3_kernel_prepare(blake3_kernel_job* job, const blake3_hasher* base, int difficulty)
+{
+  const blake3_chunk_state* chunk = &base->chunk;
+
+  // 가장 긴 nonce를 더해도 첫 청크 안에 들어가야 마지막 블록이 곧 루트가 된다.
+  if (base->cvStackLen != 0 || chunk->chunkCounter != 0
+      || (size_t)BLAKE3_BLOCK_LEN * chunk->blocksCompressed + chunk->blockLen + MAX_DIGITS > BLAKE3_CHUNK_LEN) {
+    return false;
+  }
+
+  for (int i = 0; i < 8; i++) {
+    for (int lane = 0; lane < BLAKE3_LANES; lane++) {
+      job->cv[i][lane] = chunk->cv[i];
+    }
+  }
+  memcpy(job->tail, chunk->block, chunk->blockLen);
+  job->tailLength = chunk->blockLen;
+  job->flags = chunk->flags | (chunk->blocksCompressed == 0 ? BLAKE3_CHUNK_START : 0);
+
+  // 꼬리가 가득 찼다면 nonce는 다음 블록에 들어가므로, 꼬리 블록은 미리 압축해 둔다.
+  if (chunk->blockLen == BLAKE3_BLOCK_LEN) {
+    uint32_t block[16][BLAKE3_LANES];
+    for (int i = 0; i < 16; i++) {
+      uint32_t word = load32(chunk->block + i * 4);
+      for (int lane = 0; lane < BLAKE3_LANES; lane++) {
+        block[i][lane] = word;
+      }
+    }
+    blake3_compress_lanes(job->cv, block, 0, BLAKE3_BLOCK_LEN, job->flags);
+    job->tailLength = 0;
+    job->flags = chunk->flags;
+  }
+
+  // 16진수 한 자리는 4비트이므로, 난이도만큼의 상위 비트가 0이어야 한다.
+  if (difficulty > 64) {
+    difficulty = 64;
+  }
+  job->zeroWords = difficulty / 8;
+  job->zeroMask = difficulty % 8 == 0 ? 0 : 0xFFFFFFFFu << (32 - difficulty % 8 * 4);
+  return true;
+}
+
+int blake3_kernel_search(const blake3_kernel_job* job, unsigned int* nonce, char hashresult[65], unsigned int startNonce, unsigned long long nonceRange, const volatile bool* cancel)
+{
+  unsigned long long next = startNonce;
+  unsigned long long end = startNonce + nonceRange;
+
+  // 범위를 nonce 자릿수가 같은 구간으로 나누어, 구간마다 블록 배치를 한 번 정한다.
+  while (next < end) {
+    int digits = 1;
+    unsigned long long classEnd = 10;
+    while (next >= classEnd) {
+      digits++;
+      classEnd *= 10;
+    }
+    if (classEnd > end) {
+      classEnd = end;
+    }
+
+    int res = searchDigits(job, digits, next, classEnd - next, nonce, hashresult, cancel);
+    if (res != POW_NOTFOUND) {
+      return res;
+    }
+    next = classEnd;
+  }
+
+  *nonce = -1;
+  sprintf(hashresult, "failed");
+  return POW_NOTFOUND;
+}
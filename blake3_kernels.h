@@ -0,0 +1,35 @@
+#ifndef BLAKE3_KERNELS_H
+#define BLAKE3_KERNELS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "blake3.h"
+
+// 범위 하나를 레인 커널로 탐색하기 위해 미리 계산해 둔 값
+typedef struct _BLAKE3_Kernel_Job {
+  uint32_t cv[8][BLAKE3_LANES];   // 챌린지의 앞 블록들을 반영한 연쇄값 (모든 레인에 같은 값)
+  uint8_t tail[BLAKE3_BLOCK_LEN]; // 아직 압축하지 않은 챌린지 꼬리. 항상 64바이트 미만이다
+  unsigned int tailLength;
+  uint32_t flags;                 // 꼬리가 든 블록의 플래그 (BLAKE3_CHUNK_START 포함 여부)
+  int zeroWords;                  // 0이어야 하는 해시 워드 수 (빅 엔디언으로 읽은 워드)
+  uint32_t zeroMask;              // 그다음 워드에서 0이어야 하는 비트
+} blake3_kernel_job;
+
+/// @brief 챌린지를 반영한 BLAKE3 상태와 난이도로 커널 작업을 준비한다
+/// @param job 준비할 커널 작업
+/// @param base 챌린지를 반영한 BLAKE3 상태
+/// @param difficulty 난이도 (해시값 앞의 '0' 개수)
+/// @return 챌린지와 nonce가 첫 청크 안에 들어가 커널을 쓸 수 있으면 true
+bool blake3_kernel_prepare(blake3_kernel_job* job, const blake3_hasher* base, int difficulty);
+
+/// @brief 범위를 nonce 자릿수별로 나누고, 연속한 nonce BLAKE3_LANES개를 레인에 나누어 해시하며 첫 번째 정답을 찾는다
+/// @param job blake3_kernel_prepare로 준비한 커널 작업
+/// @param nonce 찾은 nonce
+/// @param hashresult 찾은 nonce의 해시값
+/// @param startNonce 시작 nonce값
+/// @param nonceRange nonce 범위
+/// @param cancel 중단 플래그. NULL이면 terminateFindNonce만 확인
+/// @return findNonceUntil과 같다
+int blake3_kernel_search(const blake3_kernel_job* job, unsigned int* nonce, char hashresult[65], unsigned int startNonce, unsigned long long nonceRange, const volatile bool* cancel);
+
+#endif
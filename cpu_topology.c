@@ -0,0 +1,236 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include "cpu_topology.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+#define SYSFS_NODE "/sys/devices/system/node"
+
+/**
+ * @brief sysfs 파일에서 정수 하나를 읽는 함수이다.
+ *
+ * @param path 파일 경로
+ * @param value 읽은 값
+ * @return int 성공 시 0, 실패 시 -1
+ */
+static int readInt(const char* path, int* value)
+{
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    return -1;
+  }
+  int res = fscanf(fp, "%d", value) == 1 ? 0 : -1;
+  fclose(fp);
+  return res;
+}
+
+/**
+ * @brief "0-3,8-11" 형식의 CPU 목록 파일을 읽어 각 CPU마다 콜백을 호출하는 함수이다.
+ *
+ * @param path 파일 경로
+ * @param onCpu 목록의 CPU마다 호출되는 콜백
+ * @param arg 콜백에 전달되는 인자
+ * @return int 성공 시 0, 실패 시 -1
+ */
+static int readCpuList(const char* path, void (*onCpu)(int, void*), void* arg)
+{
+  char list[4096];
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    return -1;
+  }
+  if (fgets(list, sizeof(list), fp) == NULL) {
+    fclose(fp);
+    return -1;
+  }
+  fclose(fp);
+
+  char* save;
+  for (char* token = strtok_r(list, ",\n", &save); token != NULL; token = strtok_r(NULL, ",\n", &save)) {
+    int first, last;
+    int n = sscanf(token, "%d-%d", &first, &last);
+    if (n < 1) {
+      continue;
+    }
+    if (n == 1) {
+      last = first;
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      onCpu(cpu, arg);
+    }
+  }
+  return 0;
+}
+
+static void addOnlineCpu(int cpu, void* arg)
+{
+  cpu_topology* topology = (cpu_topology*)arg;
+  if (topology->cpuCount >= TOPOLOGY_MAX_CPUS) {
+    return;
+  }
+  cpu_info* info = &topology->cpus[topology->cpuCount++];
+  memset(info, 0, sizeof(*info));
+  info->cpu = cpu;
+  info->core = cpu;
+}
+
+typedef struct {
+  cpu_topology* topology;
+  int node;
+} NodeParams;
+
+static void setCpuNode(int cpu, void* arg)
+{
+  NodeParams* params = (NodeParams*)arg;
+  for (int i = 0; i < params->topology->cpuCount; i++) {
+    if (params->topology->cpus[i].cpu == cpu) {
+      params->topology->cpus[i].node = params->node;
+    }
+  }
+}
+
+int topology_discover(cpu_topology* topology)
+{
+  char path[256];
+  bool isFallback = false;
+
+  memset(topology, 0, sizeof(*topology));
+
+  // 온라인 CPU 목록을 읽는다. 실패하면 CPU 번호를 0부터 차례로 가정한다.
+  if (readCpuList(SYSFS_CPU "/online", addOnlineCpu, topology) != 0 || topology->cpuCount == 0) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    topology->cpuCount = 0;
+    for (long cpu = 0; cpu < count && cpu < TOPOLOGY_MAX_CPUS; cpu++) {
+      addOnlineCpu(cpu, topology);
+    }
+    isFallback = true;
+  }
+
+  // CPU마다 소켓과 물리 코어 번호를 읽는다.
+  for (int i = 0; i < topology->cpuCount; i++) {
+    cpu_info* info = &topology->cpus[i];
+    snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/core_id", info->cpu);
+    if (readInt(path, &info->core) != 0) {
+      info->core = info->cpu;
+      isFallback = true;
+    }
+    snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/physical_package_id", info->cpu);
+    if (readInt(path, &info->package) != 0) {
+      info->package = 0;
+    }
+  }
+
+  // NUMA 노드별 CPU 목록을 읽는다.
+  topology->nodeCount = 1;
+  for (int node = 0; node < TOPOLOGY_MAX_CPUS; node++) {
+    NodeParams params = { topology, node };
+    snprintf(path, sizeof(path), SYSFS_NODE "/node%d/cpulist", node);
+    if (readCpuList(path, setCpuNode, &params) != 0) {
+      if (access(SYSFS_NODE, F_OK) != 0 || node > 0) {
+        break;
+      }
+      continue;
+    }
+    topology->nodeCount = node + 1;
+  }
+
+  // 같은 (소켓, 코어)를 공유하는 CPU 중 첫 번째만 주 CPU로 표시한다.
+  for (int i = 0; i < topology->cpuCount; i++) {
+    cpu_info* info = &topology->cpus[i];
+    info->isPrimary = true;
+    for (int j = 0; j < i; j++) {
+      if (topology->cpus[j].package == info->package && topology->cpus[j].core == info->core) {
+        info->isPrimary = false;
+        break;
+      }
+    }
+    if (info->isPrimary) {
+      topology->coreCount++;
+    }
+  }
+
+  return isFallback ? 1 : 0;
+}
+
+/**
+ * @brief 조건에 맞는 CPU를 NUMA 노드를 번갈아 가며 골라 배열에 추가하는 함수이다.
+ * 노드마다 같은 수의 해시 스레드가 배치되어 메모리 대역폭과 캐시를 고르게 사용하게 된다.
+ */
+static int appendRoundRobin(const cpu_topology* topology, bool primary, bool* used, int* cpus, int count)
+{
+  bool added = true;
+  while (added) {
+    added = false;
+    for (int node = 0; node < topology->nodeCount; node++) {
+      for (int i = 0; i < topology->cpuCount; i++) {
+        const cpu_info* info = &topology->cpus[i];
+        if (used[i] || info->node != node || info->isPrimary != primary) {
+          continue;
+        }
+        used[i] = true;
+        cpus[count++] = info->cpu;
+        added = true;
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+int topology_plan(const cpu_topology* topology, int threadCount, bool useSmt, int* hashCpus, int* ioCpu)
+{
+  bool used[TOPOLOGY_MAX_CPUS] = { false };
+  int candidates[TOPOLOGY_MAX_CPUS];
+  int count = 0;
+
+  *ioCpu = -1;
+
+  // 해시 스레드 후보: 물리 코어의 주 CPU를 먼저, 필요하면 SMT 형제를 뒤에 둔다.
+  count = appendRoundRobin(topology, true, used, candidates, count);
+  int primaryCount = count;
+  if (useSmt) {
+    count = appendRoundRobin(topology, false, used, candidates, count);
+  }
+
+  // 네트워크 스레드 CPU: 해시에 쓰지 않는 SMT 형제가 있으면 그것을, 없으면 마지막 물리 코어를 비워 둔다.
+  for (int i = 0; i < topology->cpuCount; i++) {
+    if (!used[i]) {
+      *ioCpu = topology->cpus[i].cpu;
+      break;
+    }
+  }
+  if (*ioCpu < 0 && primaryCount > 1 && (threadCount <= 0 || threadCount < count)) {
+    *ioCpu = candidates[--count];
+  }
+
+  if (count == 0) {
+    return 0;
+  }
+  if (threadCount <= 0) {
+    threadCount = count;
+  }
+  if (threadCount > TOPOLOGY_MAX_CPUS) {
+    threadCount = TOPOLOGY_MAX_CPUS;
+  }
+  // 후보보다 스레드가 많으면 후보를 처음부터 다시 사용한다.
+  for (int i = 0; i < threadCount; i++) {
+    hashCpus[i] = candidates[i % count];
+  }
+  return threadCount;
+}
+
+int topology_pin_self(int cpu)
+{
+  if (cpu < 0) {
+    return 0;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
@@ -0,0 +1,44 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <stdbool.h>
+
+#define TOPOLOGY_MAX_CPUS 1024
+
+typedef struct _CPU_Info {
+  int cpu;        // 논리 CPU 번호
+  int core;       // 패키지 안의 물리 코어 번호
+  int package;    // 소켓(물리 패키지) 번호
+  int node;       // NUMA 노드 번호
+  bool isPrimary; // 물리 코어의 첫 번째 논리 CPU인지 여부 (나머지는 SMT 형제)
+} cpu_info;
+
+typedef struct _CPU_Topology {
+  cpu_info cpus[TOPOLOGY_MAX_CPUS];
+  int cpuCount;   // 온라인 논리 CPU 수
+  int coreCount;  // 물리 코어 수
+  int nodeCount;  // NUMA 노드 수
+} cpu_topology;
+
+/// @brief sysfs에서 CPU 토폴로지(물리 코어, SMT 형제, NUMA 노드)를 읽어온다
+/// @param topology 토폴로지가 저장될 구조체
+/// @return 성공 시 0, sysfs를 읽지 못해 CPU마다 독립 코어로 가정한 경우 1
+int topology_discover(cpu_topology* topology);
+
+/// @brief 해시 스레드와 네트워크 스레드를 배치할 CPU를 정한다
+/// 해시 스레드는 NUMA 노드를 번갈아 가며 물리 코어마다 하나씩 배치하고, useSmt이면 SMT 형제도 사용한다.
+/// 네트워크 스레드는 해시 스레드가 쓰지 않는 CPU에 배치한다.
+/// @param topology 토폴로지
+/// @param threadCount 해시 스레드 수. 0 이하이면 사용 가능한 코어 수만큼
+/// @param useSmt SMT 형제를 해시 스레드에 사용할지 여부
+/// @param hashCpus 해시 스레드별 CPU 번호가 저장될 배열 (TOPOLOGY_MAX_CPUS 크기)
+/// @param ioCpu 네트워크 스레드의 CPU 번호. 따로 둘 CPU가 없으면 -1
+/// @return 해시 스레드 수
+int topology_plan(const cpu_topology* topology, int threadCount, bool useSmt, int* hashCpus, int* ioCpu);
+
+/// @brief 호출한 스레드를 지정한 CPU에 고정한다
+/// @param cpu CPU 번호. 음수이면 아무것도 하지 않는다
+/// @return 성공 시 0
+int topology_pin_self(int cpu);
+
+#endif
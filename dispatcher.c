@@ -0,0 +1,388 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "dispatcher.h"
+
+typedef struct {
+  unsigned int magic;
+  unsigned int version;
+  unsigned char key[32];
+} LogHeader;
+
+/**
+ * @brief nonce보다 끝이 큰 첫 번째 완료 범위의 위치를 이진 탐색으로 찾는 함수이다.
+ */
+static int findDone(const dispatcher* d, unsigned long long nonce)
+{
+  int low = 0, high = d->doneCount;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (d->done[mid].end <= nonce) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/**
+ * @brief 완료 범위를 정렬된 목록에 추가하고 겹치거나 맞닿은 범위를 병합하는 함수이다.
+ */
+static int addDone(dispatcher* d, unsigned long long start, unsigned long long end)
+{
+  if (start >= end) {
+    return 0;
+  }
+  if (d->doneCount == d->doneCapacity) {
+    int capacity = d->doneCapacity > 0 ? d->doneCapacity * 2 : 64;
+    nonce_range* grown = (nonce_range*)realloc(d->done, capacity * sizeof(nonce_range));
+    if (grown == NULL) {
+      return -1;
+    }
+    d->done = grown;
+    d->doneCapacity = capacity;
+  }
+
+  // start보다 앞에서 끝나는 범위 뒤에 삽입한 뒤, 앞뒤 범위와 병합한다.
+  int pos = findDone(d, start);
+  if (pos > 0 && d->done[pos - 1].end == start) {
+    pos--;
+  }
+  int last = pos;
+  while (last < d->doneCount && d->done[last].start <= end) {
+    if (d->done[last].start < start) {
+      start = d->done[last].start;
+    }
+    if (d->done[last].end > end) {
+      end = d->done[last].end;
+    }
+    last++;
+  }
+  if (last == pos) {
+    memmove(&d->done[pos + 1], &d->done[pos], (d->doneCount - pos) * sizeof(nonce_range));
+    d->doneCount++;
+  }
+  else if (last > pos + 1) {
+    memmove(&d->done[pos + 1], &d->done[last], (d->doneCount - last) * sizeof(nonce_range));
+    d->doneCount -= last - pos - 1;
+  }
+  d->done[pos].start = start;
+  d->done[pos].end = end;
+  return 0;
+}
+
+/**
+ * @brief 다음 분배 nonce가 완료된 범위 안에 있으면 그 범위의 끝으로 옮기는 함수이다.
+ */
+static void skipDone(dispatcher* d)
+{
+  int pos = findDone(d, d->nextNonce);
+  while (pos < d->doneCount && d->done[pos].start <= d->nextNonce) {
+    d->nextNonce = d->done[pos].end;
+    pos++;
+  }
+}
+
+/**
+ * @brief 레코드 하나를 로그 끝에 덧붙이는 함수이다.
+ * 호출자의 뮤텍스 안에서는 write만 하고, 디스크 반영은 동기화 스레드가 여러 레코드를 묶어서 한다.
+ */
+static void appendRecord(dispatcher* d, const dispatcher_record* record, const char* hash)
+{
+  char buffer[sizeof(dispatcher_record) + 64];
+  int size = sizeof(dispatcher_record);
+  memcpy(buffer, record, size);
+  if (hash != NULL) {
+    memcpy(buffer + size, hash, 64);
+    size += 64;
+  }
+  // 레코드를 한 번의 write로 기록하여 중간에 끊기더라도 마지막 레코드만 잘리게 한다.
+  if (write(d->logFd, buffer, size) == size) {
+    pthread_mutex_lock(&d->syncMutex);
+    if (++d->unsyncedRecords >= DISPATCHER_SYNC_BATCH) {
+      pthread_cond_signal(&d->syncCond);
+    }
+    pthread_mutex_unlock(&d->syncMutex);
+  }
+}
+
+/**
+ * @brief 쌓인 레코드가 DISPATCHER_SYNC_BATCH개가 되거나 DISPATCHER_SYNC_INTERVAL_MS가 지날 때마다
+ * 로그를 fdatasync하는 스레드 함수이다. 중단되면 남은 레코드를 반영하고 끝난다.
+ */
+static void* syncMain(void* arg)
+{
+  dispatcher* d = (dispatcher*)arg;
+
+  pthread_mutex_lock(&d->syncMutex);
+  while (true) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += DISPATCHER_SYNC_INTERVAL_MS * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    while (!d->isSyncStopped && d->unsyncedRecords < DISPATCHER_SYNC_BATCH) {
+      if (pthread_cond_timedwait(&d->syncCond, &d->syncMutex, &deadline) != 0) {
+        break;
+      }
+    }
+
+    bool isStopped = d->isSyncStopped;
+    if (d->unsyncedRecords > 0) {
+      // 기록 중인 스레드를 막지 않도록 뮤텍스를 풀고 반영한다. 그동안 들어온 레코드는 다음 번에 반영된다.
+      d->unsyncedRecords = 0;
+      pthread_mutex_unlock(&d->syncMutex);
+      fdatasync(d->logFd);
+      pthread_mutex_lock(&d->syncMutex);
+    }
+    if (isStopped && d->unsyncedRecords == 0) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&d->syncMutex);
+  return NULL;
+}
+
+void dispatcher_init(dispatcher* d, unsigned int workload, unsigned long long startNonce, unsigned long long searchEnd)
+{
+  memset(d, 0, sizeof(*d));
+  d->nextNonce = startNonce;
+  d->workload = workload;
+  d->searchEnd = searchEnd;
+  d->logFd = -1;
+}
+
+int dispatcher_open_log(dispatcher* d, const char* path, const unsigned char key[32])
+{
+  LogHeader header;
+  dispatcher_record record;
+  char hash[64];
+
+  // 같은 작업의 로그가 있으면 완료된 범위와 정답을 읽는다. 잘린 마지막 레코드는 무시한다.
+  int fd = open(path, O_RDONLY);
+  if (fd >= 0) {
+    if (read(fd, &header, sizeof(header)) == sizeof(header) && header.magic == DISPATCHER_LOG_MAGIC
+        && header.version == DISPATCHER_LOG_VERSION && memcmp(header.key, key, 32) == 0) {
+      while (read(fd, &record, sizeof(record)) == sizeof(record)) {
+        if (record.type == DISPATCHER_RECORD_RANGE) {
+          addDone(d, record.start, (unsigned long long)record.start + record.length);
+        }
+        else if (record.type == DISPATCHER_RECORD_HIT) {
+          if (read(fd, hash, sizeof(hash)) != sizeof(hash)) {
+            break;
+          }
+          dwp_result* grown = (dwp_result*)realloc(d->hits, (d->hitCount + 1) * sizeof(dwp_result));
+          if (grown == NULL) {
+            break;
+          }
+          d->hits = grown;
+          d->hits[d->hitCount].nonce = record.start;
+          memcpy(d->hits[d->hitCount].hash, hash, sizeof(hash));
+          d->hitCount++;
+        }
+      }
+    }
+    close(fd);
+  }
+
+  // 병합된 범위와 정답만 담은 새 로그를 만든 뒤 기존 로그와 교체한다.
+  size_t pathLen = strlen(path);
+  char* tmpPath = (char*)malloc(pathLen + 5);
+  if (tmpPath == NULL) {
+    return -1;
+  }
+  snprintf(tmpPath, pathLen + 5, "%s.tmp", path);
+  fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    free(tmpPath);
+    return -1;
+  }
+  header.magic = DISPATCHER_LOG_MAGIC;
+  header.version = DISPATCHER_LOG_VERSION;
+  memcpy(header.key, key, 32);
+  bool isWritten = write(fd, &header, sizeof(header)) == sizeof(header);
+  for (int i = 0; i < d->doneCount && isWritten; i++) {
+    // 4바이트 길이 필드에 맞도록 큰 범위는 나누어 기록한다.
+    for (unsigned long long start = d->done[i].start; start < d->done[i].end && isWritten; start += 0x80000000ULL) {
+      unsigned long long end = d->done[i].end - start > 0x80000000ULL ? start + 0x80000000ULL : d->done[i].end;
+      record.type = DISPATCHER_RECORD_RANGE;
+      record.start = start;
+      record.length = end - start;
+      isWritten = write(fd, &record, sizeof(record)) == sizeof(record);
+    }
+    if (d->done[i].start < d->searchEnd) {
+      d->resumedNonces += (d->done[i].end < d->searchEnd ? d->done[i].end : d->searchEnd) - d->done[i].start;
+    }
+  }
+  for (int i = 0; i < d->hitCount && isWritten; i++) {
+    record.type = DISPATCHER_RECORD_HIT;
+    record.start = d->hits[i].nonce;
+    record.length = 0;
+    isWritten = write(fd, &record, sizeof(record)) == sizeof(record)
+      && write(fd, d->hits[i].hash, 64) == 64;
+  }
+  if (!isWritten || fsync(fd) != 0) {
+    close(fd);
+    unlink(tmpPath);
+    free(tmpPath);
+    return -1;
+  }
+  close(fd);
+  if (rename(tmpPath, path) != 0) {
+    unlink(tmpPath);
+    free(tmpPath);
+    return -1;
+  }
+  free(tmpPath);
+
+  d->logFd = open(path, O_WRONLY | O_APPEND);
+  if (d->logFd < 0) {
+    return -1;
+  }
+  pthread_mutex_init(&d->syncMutex, NULL);
+  pthread_cond_init(&d->syncCond, NULL);
+  if (pthread_create(&d->syncThread, NULL, syncMain, d) != 0) {
+    pthread_cond_destroy(&d->syncCond);
+    pthread_mutex_destroy(&d->syncMutex);
+    close(d->logFd);
+    d->logFd = -1;
+    return -1;
+  }
+  d->logPath = strdup(path);
+  return 0;
+}
+
+bool dispatcher_next(dispatcher* d, unsigned int* start, unsigned int* length)
+{
+  // 되돌려진 범위를 먼저 다시 분배한다.
+  if (d->retryCount > 0) {
+    d->retryCount--;
+    *start = d->retry[d->retryCount].start;
+    *length = d->retry[d->retryCount].end - d->retry[d->retryCount].start;
+    d->issuedRanges++;
+    return true;
+  }
+
+  skipDone(d);
+  if (d->nextNonce >= d->searchEnd) {
+    return false;
+  }
+
+  // 범위의 끝은 작업량, 탐색 종료 nonce, 다음 완료 범위의 시작 중 가장 가까운 곳이다.
+  unsigned long long end = d->nextNonce + d->workload;
+  if (end > d->searchEnd) {
+    end = d->searchEnd;
+  }
+  int pos = findDone(d, d->nextNonce);
+  if (pos < d->doneCount && d->done[pos].start < end) {
+    end = d->done[pos].start;
+  }
+
+  *start = d->nextNonce;
+  *length = end - d->nextNonce;
+  d->nextNonce = end;
+  d->issuedRanges++;
+  return true;
+}
+
+bool dispatcher_complete(dispatcher* d, unsigned int start, unsigned int length)
+{
+  d->completedRanges++;
+  if (length > 0) {
+    addDone(d, start, (unsigned long long)start + length);
+    if (d->logFd >= 0) {
+      dispatcher_record record = { DISPATCHER_RECORD_RANGE, start, length };
+      appendRecord(d, &record, NULL);
+    }
+  }
+  return dispatcher_is_done(d);
+}
+
+int dispatcher_on_fail(dispatcher* d, unsigned int start, unsigned int length)
+{
+  bool isDone = dispatcher_complete(d, start, length);
+  // 정답을 받은 뒤에는 이미 중단 요청을 보냈으므로, 늦게 도착한 실패 응답에는 할 일이 없다.
+  if (d->isSolved) {
+    return DISPATCHER_ACTION_NONE;
+  }
+  return isDone ? DISPATCHER_ACTION_STOP : DISPATCHER_ACTION_NEXT;
+}
+
+int dispatcher_on_success(dispatcher* d, unsigned int nonce)
+{
+  if (d->isSolved) {
+    return DISPATCHER_ACTION_NONE;
+  }
+  d->isSolved = true;
+  d->solvedNonce = nonce;
+  return DISPATCHER_ACTION_STOP;
+}
+
+int dispatcher_release(dispatcher* d, unsigned int start, unsigned int length)
+{
+  if (d->retryCount == d->retryCapacity) {
+    int capacity = d->retryCapacity > 0 ? d->retryCapacity * 2 : 16;
+    nonce_range* grown = (nonce_range*)realloc(d->retry, capacity * sizeof(nonce_range));
+    if (grown == NULL) {
+      return -1;
+    }
+    d->retry = grown;
+    d->retryCapacity = capacity;
+  }
+  d->retry[d->retryCount].start = start;
+  d->retry[d->retryCount].end = (unsigned long long)start + length;
+  d->retryCount++;
+  d->completedRanges++;
+  return 0;
+}
+
+void dispatcher_record_hit(dispatcher* d, const dwp_result* hit)
+{
+  if (d->logFd >= 0) {
+    dispatcher_record record = { DISPATCHER_RECORD_HIT, hit->nonce, 0 };
+    appendRecord(d, &record, hit->hash);
+  }
+}
+
+bool dispatcher_is_done(dispatcher* d)
+{
+  skipDone(d);
+  return d->nextNonce >= d->searchEnd && d->completedRanges >= d->issuedRanges && d->retryCount == 0;
+}
+
+void dispatcher_destroy(dispatcher* d, bool removeLog)
+{
+  if (d->logFd >= 0) {
+    // 동기화 스레드가 남은 레코드를 반영한 뒤에 로그를 닫는다.
+    pthread_mutex_lock(&d->syncMutex);
+    d->isSyncStopped = true;
+    pthread_cond_signal(&d->syncCond);
+    pthread_mutex_unlock(&d->syncMutex);
+    pthread_join(d->syncThread, NULL);
+    pthread_cond_destroy(&d->syncCond);
+    pthread_mutex_destroy(&d->syncMutex);
+    close(d->logFd);
+    d->logFd = -1;
+  }
+  if (removeLog && d->logPath != NULL) {
+    unlink(d->logPath);
+  }
+  free(d->logPath);
+  free(d->done);
+  free(d->retry);
+  free(d->hits);
+  d->logPath = NULL;
+  d->done = NULL;
+  d->retry = NULL;
+  d->retryCount = 0;
+  d->hits = NULL;
+}
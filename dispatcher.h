@@ -0,0 +1,121 @@
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "dwp.h"
+
+#define DISPATCHER_LOG_MAGIC 0x4B435744 // "DWCK"
+#define DISPATCHER_LOG_VERSION 1
+#define DISPATCHER_RECORD_RANGE 0 // 완료된 범위 기록
+#define DISPATCHER_RECORD_HIT 1   // 정답 기록 (모든 정답/상위 k개 모드)
+#define DISPATCHER_SYNC_BATCH 64    // 이만큼 레코드가 쌓이면 기다리지 않고 디스크에 반영한다
+#define DISPATCHER_SYNC_INTERVAL_MS 50 // 레코드를 디스크에 반영하는 최대 간격
+#define DISPATCHER_PREFETCH_DEPTH 2 // 작업서버마다 미리 할당해 두는 작업 범위 수 (메인서버, 시뮬레이터 공통)
+
+// 작업서버의 응답을 받은 뒤 메인서버가 할 일 (메인서버, 시뮬레이터 공통)
+#define DISPATCHER_ACTION_NONE 0    // 할 일이 없다
+#define DISPATCHER_ACTION_NEXT 1    // 응답한 작업서버에 다음 범위를 분배한다
+#define DISPATCHER_ACTION_STOP 2    // 작업을 끝내고 모든 작업서버에 중단 요청을 보낸다
+
+typedef struct _Nonce_Range {
+  unsigned long long start;
+  unsigned long long end;   // 범위 끝 (포함하지 않음)
+} nonce_range;
+
+// 체크포인트 로그의 레코드. DISPATCHER_RECORD_HIT인 경우 64바이트 해시값이 뒤따른다.
+typedef struct _Dispatcher_Record {
+  unsigned int type;
+  unsigned int start;
+  unsigned int length;
+} dispatcher_record;
+
+typedef struct _Dispatcher {
+  unsigned long long nextNonce;   // 다음에 분배할 nonce
+  unsigned long long searchEnd;   // 탐색 종료 nonce
+  unsigned int workload;          // 범위 하나의 크기
+  unsigned int issuedRanges;      // 분배한 범위 수
+  unsigned int completedRanges;   // 분배한 범위 중 완료된 범위 수
+  unsigned long long resumedNonces; // 이전 실행에서 이미 탐색된 nonce 수
+  nonce_range* done;              // 완료된 범위 (정렬, 병합됨)
+  int doneCount;
+  int doneCapacity;
+  nonce_range* retry;             // 작업서버가 거부하여 다시 분배할 범위
+  int retryCount;
+  int retryCapacity;
+  bool isSolved;                  // 첫 정답을 받았는지 여부
+  unsigned int solvedNonce;       // 가장 먼저 받은 정답. isSolved가 true일 때만 유효하다
+  dwp_result* hits;               // 이전 실행에서 기록된 정답
+  int hitCount;
+  int logFd;                      // 체크포인트 로그 파일. 없으면 -1
+  char* logPath;
+  pthread_t syncThread;           // 쌓인 레코드를 묶어서 fdatasync하는 스레드 (로그를 연 경우에만)
+  pthread_mutex_t syncMutex;      // unsyncedRecords, isSyncStopped 보호
+  pthread_cond_t syncCond;
+  unsigned int unsyncedRecords;   // 기록했지만 아직 디스크에 반영하지 않은 레코드 수
+  bool isSyncStopped;
+} dispatcher;
+
+/// @brief 분배기를 초기화한다
+/// @param d 분배기
+/// @param workload 범위 하나의 크기
+/// @param startNonce 탐색 시작 nonce
+/// @param searchEnd 탐색 종료 nonce
+void dispatcher_init(dispatcher* d, unsigned int workload, unsigned long long startNonce, unsigned long long searchEnd);
+
+/// @brief 체크포인트 로그를 연다. 같은 작업의 로그가 있으면 완료된 범위와 정답을 읽어 이어서 탐색한다
+/// 읽은 로그는 병합된 범위만 남도록 압축하여 다시 쓴다. 이후 기록하는 레코드는 동기화 스레드가 묶어서 디스크에 반영한다.
+/// @param d 분배기
+/// @param path 로그 파일 경로
+/// @param key 작업 식별자 (챌린지, 난이도, 탐색 모드의 다이제스트)
+/// @return 성공 시 0, 실패 시 -1
+int dispatcher_open_log(dispatcher* d, const char* path, const unsigned char key[32]);
+
+/// @brief 아직 탐색하지 않은 다음 범위를 할당한다. 이미 완료된 범위는 건너뛴다
+/// @param d 분배기
+/// @param start 할당된 범위의 시작 nonce
+/// @param length 할당된 범위의 크기
+/// @return 할당할 범위가 없으면 false
+bool dispatcher_next(dispatcher* d, unsigned int* start, unsigned int* length);
+
+/// @brief 범위가 완료되었음을 기록한다
+/// @param d 분배기
+/// @param start 완료된 범위의 시작 nonce
+/// @param length 완료된 범위의 크기
+/// @return 분배할 범위가 남지 않았고 분배한 범위가 모두 완료되었으면 true
+bool dispatcher_complete(dispatcher* d, unsigned int start, unsigned int length);
+
+/// @brief 작업서버의 실패 응답(범위에 정답 없음)을 처리한다. 범위 완료를 기록하고 다음에 할 일을 정한다
+/// @param d 분배기
+/// @param start 완료된 범위의 시작 nonce
+/// @param length 완료된 범위의 크기
+/// @return 이미 정답을 받았으면 DISPATCHER_ACTION_NONE, 분배한 범위가 모두 완료되었으면 DISPATCHER_ACTION_STOP,
+/// 그 밖에는 같은 작업서버에 다음 범위를 분배하도록 DISPATCHER_ACTION_NEXT
+int dispatcher_on_fail(dispatcher* d, unsigned int start, unsigned int length);
+
+/// @brief 작업서버의 성공 응답을 처리한다. 가장 먼저 도착한 정답만 채택한다
+/// @param d 분배기
+/// @param nonce 작업서버가 찾은 nonce
+/// @return 처음 받은 정답이면 DISPATCHER_ACTION_STOP, 이미 정답을 받았으면 DISPATCHER_ACTION_NONE
+int dispatcher_on_success(dispatcher* d, unsigned int nonce);
+
+/// @brief 작업서버가 탐색하지 못하고 돌려준 범위를 다시 분배하도록 되돌린다
+/// 범위는 완료로 기록되지 않으며, dispatcher_next가 새 범위보다 먼저 할당한다.
+/// @param d 분배기
+/// @param start 되돌릴 범위의 시작 nonce
+/// @param length 되돌릴 범위의 크기
+/// @return 성공 시 0, 메모리가 부족하면 -1
+int dispatcher_release(dispatcher* d, unsigned int start, unsigned int length);
+
+/// @brief 정답을 체크포인트 로그에 기록한다
+void dispatcher_record_hit(dispatcher* d, const dwp_result* hit);
+
+/// @brief 분배할 범위가 남지 않았고 분배한 범위가 모두 완료되었는지 확인한다
+bool dispatcher_is_done(dispatcher* d);
+
+/// @brief 분배기의 자원을 반환한다
+/// @param d 분배기
+/// @param removeLog 작업이 끝나 체크포인트 로그가 더 이상 필요 없으면 true
+void dispatcher_destroy(dispatcher* d, bool removeLog);
+
+#endif
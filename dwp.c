@@ -1,30 +1,11 @@
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/socket.h>
-
-#define DWP_HEADER_LENGTH 10  // DWP 패킷 헤더 길이
-#define DWP_BODY_LENGTH 127 // DWP 패킷 바디 최대 길이
-#define DWP_LENGTH (DWP_HEADER_LENGTH + DWP_BODY_LENGTH)  // DWP 패킷 최대 길이
-#define DWP_QR_REQUEST 0  // DWP 패킷 QR-요청 필드
-#define DWP_QR_RESPONSE 1 // DWP 패킷 QR-응답 필드
-#define DWP_TYPE_WORK 0 // DWP 패킷 Type-작업요청 필드
-#define DWP_TYPE_STOP 1 // DWP 패킷 Type-중단요청 필드
-#define DWP_TYPE_SUCCESS 0  // DWP 패킷 Type-성공 필드
-#define DWP_TYPE_FAIL 1 // DWP 패킷 Type-실패 필드
-
-typedef struct _DWP_Header_Data {
-  unsigned short qr : 1;
-  unsigned short type : 2;
-  unsigned short difficulty : 6;
-  unsigned short bodylen : 7;
-} dwp_header_data;
-
-typedef struct _DWP_Packet {
-  dwp_header_data data;
-  unsigned int nonce;
-  unsigned int workload;
-  char* challenge;
-} dwp_packet;
+#include <sys/uio.h>
+#include <poll.h>
+#include "dwp.h"
+#include "perf_trace.h"
 
 /**
  * @brief 초기 DWP 요청 패킷을 생성하는 함수이다.
@@ -44,6 +25,8 @@ int dwp_create_req(int difficulty, unsigned int workload, const char* challenge,
   packet->data.bodylen = bodylen;
   packet->nonce = 0;
   packet->workload = workload;
+  memset(&packet->ext, 0, sizeof(packet->ext));
+  packet->extBody = NULL;
   packet->challenge = strdup(challenge);
   if (packet->challenge == NULL) {
     return -1;
@@ -70,6 +53,8 @@ int dwp_create_res(int difficulty, unsigned int nonce, unsigned int workload, co
   packet->data.bodylen = bodylen;
   packet->nonce = nonce;
   packet->workload = workload;
+  memset(&packet->ext, 0, sizeof(packet->ext));
+  packet->extBody = NULL;
   packet->challenge = strdup(challenge);
   if (packet->challenge == NULL) {
     return -1;
@@ -77,6 +62,120 @@ int dwp_create_res(int difficulty, unsigned int nonce, unsigned int workload, co
   return 0;
 }
 
+/**
+ * @brief 작업중단 요청 또는 실패 응답 패킷을 생성하는 함수이다.
+ * 
+ * @param qr 패킷의 QR 필드. 요청이면 중단 요청, 응답이면 실패 응답이 된다.
+ * @param packet 반환되는 중단/실패 패킷
+ * @return int 함수 실행 결과값
+ */
+int dwp_create_stop(int qr, dwp_packet* packet)
+{
+  packet->data.qr = qr;
+  packet->data.type = DWP_TYPE_STOP;
+  packet->data.difficulty = 0;
+  packet->data.bodylen = 0;
+  packet->nonce = 0;
+  packet->workload = 0;
+  packet->challenge = NULL;
+  memset(&packet->ext, 0, sizeof(packet->ext));
+  packet->extBody = NULL;
+  return 0;
+}
+
+/**
+ * @brief 챌린지가 없는 확장 패킷을 생성하는 함수이다.
+ * 
+ * @param qr 패킷의 QR 필드
+ * @param kind 확장 패킷 종류 (DWP_EXT_*)
+ * @param nonce nonce 필드
+ * @param workload 작업량 필드
+ * @param body 확장 바디. length가 0이면 NULL 가능
+ * @param length 확장 바디의 길이
+ * @param packet 반환되는 확장 패킷
+ * @return int 함수 실행 결과값
+ */
+int dwp_create_ext(int qr, int kind, unsigned int nonce, unsigned int workload, const void* body, int length, dwp_packet* packet)
+{
+  dwp_create_stop(qr, packet);
+  packet->nonce = nonce;
+  packet->workload = workload;
+  return dwp_set_ext(packet, kind, 0, body, length);
+}
+
+/**
+ * @brief 기존 패킷을 확장 패킷으로 바꾸고 확장 바디를 복사하는 함수이다.
+ * 
+ * @param packet 확장 패킷으로 바꿀 패킷 구조체
+ * @param kind 확장 패킷 종류 (DWP_EXT_*)
+ * @param count 종류별 항목 수
+ * @param body 확장 바디. length가 0이면 NULL 가능
+ * @param length 확장 바디의 길이. 최대 DWP_EXT_BODY_LENGTH
+ * @return int 함수 실행 결과값
+ */
+int dwp_set_ext(dwp_packet* packet, int kind, int count, const void* body, int length)
+{
+  if (length < 0 || length > DWP_EXT_BODY_LENGTH) {
+    return -1;
+  }
+
+  packet->data.type = DWP_TYPE_EXT;
+  packet->ext.kind = kind;
+  packet->ext.param = 0;
+  packet->ext.count = count;
+  packet->ext.length = length;
+  packet->extBody = NULL;
+  if (length > 0) {
+    packet->extBody = (char*)malloc(length);
+    if (packet->extBody == NULL) {
+      return -1;
+    }
+    memcpy(packet->extBody, body, length);
+  }
+  return 0;
+}
+
+/**
+ * @brief 확장 바디를 구조체로 복사하는 함수이다.
+ * 확장 바디가 구조체보다 짧으면 나머지 필드는 0으로 채운다.
+ * 
+ * @param packet 확장 패킷
+ * @param body 확장 바디가 복사될 구조체
+ * @param length 구조체의 크기
+ * @return int 복사된 바이트 수. 확장 패킷이 아니면 -1
+ */
+int dwp_get_ext(const dwp_packet* packet, void* body, int length)
+{
+  if (packet->data.type != DWP_TYPE_EXT) {
+    return -1;
+  }
+
+  int size = packet->ext.length < length ? packet->ext.length : length;
+  memset(body, 0, length);
+  if (size > 0) {
+    memcpy(body, packet->extBody, size);
+  }
+  return size;
+}
+
+/**
+ * @brief 두 정답을 해시값, nonce 순으로 비교하는 함수이다. qsort의 비교 함수로 사용할 수 있다.
+ * 
+ * @param a 비교할 dwp_result 포인터
+ * @param b 비교할 dwp_result 포인터
+ * @return int a가 앞서면 음수, 같으면 0, 뒤서면 양수
+ */
+int dwp_compare_result(const void* a, const void* b)
+{
+  const dwp_result* x = (const dwp_result*)a;
+  const dwp_result* y = (const dwp_result*)b;
+  int res = memcmp(x->hash, y->hash, sizeof(x->hash));
+  if (res != 0) {
+    return res;
+  }
+  return (x->nonce > y->nonce) - (x->nonce < y->nonce);
+}
+
 /**
  * @brief DWP 패킷 구조체를 기반으로 문자 배열을 생성하는 함수이다.
  * 
@@ -91,7 +190,7 @@ int dwp_to_arraybuffer(const dwp_packet* packet, char* buffer)
 
   // data 필드 복사
   size = sizeof(packet->data);
-  if ((totalSize += size) > DWP_LENGTH) {
+  if ((totalSize += size) > DWP_MAX_LENGTH) {
     return -1;
   }
   memcpy(buffer, &(packet->data), size);
@@ -99,7 +198,7 @@ int dwp_to_arraybuffer(const dwp_packet* packet, char* buffer)
 
   // nonce 필드 복사
   size = sizeof(packet->nonce);
-  if ((totalSize += size) > DWP_LENGTH) {
+  if ((totalSize += size) > DWP_MAX_LENGTH) {
     return -1;
   }
   memcpy(buffer, &(packet->nonce), size);
@@ -107,7 +206,7 @@ int dwp_to_arraybuffer(const dwp_packet* packet, char* buffer)
   
   // workload 필드 복사
   size = sizeof(packet->workload);
-  if ((totalSize += size) > DWP_LENGTH) {
+  if ((totalSize += size) > DWP_MAX_LENGTH) {
     return -1;
   }
   memcpy(buffer, &(packet->workload), size);
@@ -116,10 +215,30 @@ int dwp_to_arraybuffer(const dwp_packet* packet, char* buffer)
   if (packet->challenge != NULL) {
     // challenge 필드 복사
     size = strlen(packet->challenge);
-    if ((totalSize += size) > DWP_LENGTH) {
+    if ((totalSize += size) > DWP_MAX_LENGTH) {
       return -1;
     }
     memcpy(buffer, packet->challenge, size);  // '\0'은 buffer에서 제외된다.
+    buffer += size;
+  }
+
+  if (packet->data.type == DWP_TYPE_EXT) {
+    // 확장 헤더 복사
+    size = sizeof(packet->ext);
+    if ((totalSize += size) > DWP_MAX_LENGTH) {
+      return -1;
+    }
+    memcpy(buffer, &(packet->ext), size);
+    buffer += size;
+
+    // 확장 바디 복사
+    size = packet->ext.length;
+    if ((totalSize += size) > DWP_MAX_LENGTH) {
+      return -1;
+    }
+    if (size > 0) {
+      memcpy(buffer, packet->extBody, size);
+    }
   }
 
   return totalSize;
@@ -165,8 +284,26 @@ int dwp_to_struct(const char* buffer, dwp_packet* packet)
   else {
     packet->challenge = NULL;
   }
+  buffer += bodylen;
   totalSize += bodylen;
 
+  // 확장 헤더와 확장 바디 복사
+  memset(&(packet->ext), 0, sizeof(packet->ext));
+  packet->extBody = NULL;
+  if (packet->data.type == DWP_TYPE_EXT) {
+    size = sizeof(packet->ext);
+    memcpy(&(packet->ext), buffer, size);
+    buffer += size;
+    totalSize += size;
+
+    size = packet->ext.length;
+    if (size > 0) {
+      packet->extBody = (char*)malloc(size);
+      memcpy(packet->extBody, buffer, size);
+    }
+    totalSize += size;
+  }
+
   return totalSize;
 }
 
@@ -176,28 +313,28 @@ int dwp_to_struct(const char* buffer, dwp_packet* packet)
  * @param fd 패킷을 송신할 파일디스크립터
  * @param qr 패킷의 QR 필드
  * @param type 패킷의 TYPE 필드
- * @param packet 송신할 패킷. type이 DWP_TYPE_STOP이나 DWP_TYPE_FAIL인 경우 무시
+ * @param packet 송신할 패킷. type이 DWP_TYPE_STOP이나 DWP_TYPE_FAIL이면 NULL 가능하며,
+ *               실패 응답에 완료한 범위를 담으려면 dwp_create_stop으로 만든 패킷에 nonce와 workload를 채워 전달한다.
  * @return int 함수의 실행결과
  */
 int dwp_send(int fd, int qr, int type, const dwp_packet* packet)
 {
-  char packetArray[DWP_LENGTH];
+  char packetArray[DWP_MAX_LENGTH];
   int size;
   switch (type) {
     case DWP_TYPE_WORK:
+    case DWP_TYPE_EXT:
       size = dwp_to_arraybuffer(packet, packetArray);
       break;
     case DWP_TYPE_STOP:
       {
         // 작업중단/실패 패킷을 생성한다.
         dwp_packet tmpPacket;
-        tmpPacket.data.qr = qr;
-        tmpPacket.data.type = DWP_TYPE_STOP;
-        tmpPacket.data.difficulty = 0;
-        tmpPacket.data.bodylen = 0;
-        tmpPacket.nonce = 0;
-        tmpPacket.workload = 0;
-        tmpPacket.challenge = NULL;
+        dwp_create_stop(qr, &tmpPacket);
+        if (packet != NULL) {
+          tmpPacket.nonce = packet->nonce;
+          tmpPacket.workload = packet->workload;
+        }
         size = dwp_to_arraybuffer(&tmpPacket, packetArray);
       }
       break;
@@ -206,28 +343,129 @@ int dwp_send(int fd, int qr, int type, const dwp_packet* packet)
   }
 
   // 패킷 정보가 담긴 문자 배열을 전송한다.
+  TRACE_PROBE3(packet_send, fd, qr, type);
   int res = send(fd, packetArray, size, 0);
   return res;
 }
 
+/**
+ * @brief 여러 패킷을 한 번의 벡터 쓰기(writev)로 묶어 송신하는 함수이다.
+ * 
+ * 같은 소켓으로 보낼 패킷들이 쌓여 있을 때 시스템 콜과 TCP 세그먼트 수를 줄이기 위해 사용한다.
+ * 각 패킷은 qr, type 필드가 미리 채워져 있어야 한다.
+ * 
+ * @param fd 패킷을 송신할 파일디스크립터
+ * @param packets 송신할 패킷 배열
+ * @param count 송신할 패킷 수. 최대 DWP_BATCH_MAX
+ * @return int 송신한 총 바이트 수. 실패 시 -1
+ */
+int dwp_send_batch(int fd, const dwp_packet* packets, int count)
+{
+  char packetArray[DWP_BATCH_MAX][DWP_MAX_LENGTH];
+  struct iovec iov[DWP_BATCH_MAX];
+  int totalSize = 0;
+
+  if (count <= 0 || count > DWP_BATCH_MAX) {
+    return -1;
+  }
+
+  // 각 패킷을 직렬화하여 iovec에 연결한다.
+  for (int i = 0; i < count; i++) {
+    int size = dwp_to_arraybuffer(&packets[i], packetArray[i]);
+    if (size < 0) {
+      return -1;
+    }
+    iov[i].iov_base = packetArray[i];
+    iov[i].iov_len = size;
+    totalSize += size;
+    TRACE_PROBE3(packet_send, fd, packets[i].data.qr, packets[i].data.type);
+  }
+
+  // 부분 전송된 경우 남은 iovec부터 다시 전송한다.
+  struct iovec* cur = iov;
+  int remain = count;
+  while (remain > 0) {
+    ssize_t res = writev(fd, cur, remain);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // 논블로킹 소켓의 송신 버퍼가 가득 찬 경우 쓸 수 있을 때까지 기다린다.
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+          return -1;
+        }
+        continue;
+      }
+      return -1;
+    }
+    while (remain > 0 && (size_t)res >= cur->iov_len) {
+      res -= cur->iov_len;
+      cur++;
+      remain--;
+    }
+    if (remain > 0) {
+      cur->iov_base = (char*)cur->iov_base + res;
+      cur->iov_len -= res;
+    }
+  }
+
+  return totalSize;
+}
+
 /**
  * @brief 지정된 파일디스크립터를 통해 패킷을 수신하는 함수이다.
  * 
+ * 여러 패킷이 하나의 TCP 세그먼트로 묶여 도착할 수 있으므로, 헤더의 bodylen을 보고
+ * 정확히 한 패킷만큼만 소켓 버퍼에서 읽어온다. 패킷 전체가 도착하지 않았다면 읽지 않는다.
+ * 
  * @param fd 패킷을 수신할 파일디스크립터
  * @param packet 수신한 패킷이 담길 패킷 구조체
  * @return int 함수의 실행결과
  */
 int dwp_recv(int fd, dwp_packet* packet)
 {
-  char packetArray[DWP_LENGTH];
+  char packetArray[DWP_MAX_LENGTH];
+  dwp_header_data data;
+  dwp_ext_header ext;
   int length;
 
-  length = recv(fd, packetArray, DWP_LENGTH, 0);
-  if (length <= 0) {
+  // 헤더가 모두 도착했는지 확인한다.
+  length = recv(fd, packetArray, DWP_HEADER_LENGTH, MSG_PEEK | MSG_WAITALL);
+  if (length < DWP_HEADER_LENGTH) {
+    return -1;
+  }
+
+  // 바디까지 모두 도착했는지 확인한 뒤 한 패킷만큼만 읽는다.
+  memcpy(&data, packetArray, sizeof(data));
+  int total = DWP_HEADER_LENGTH + data.bodylen;
+  if (data.type == DWP_TYPE_EXT) {
+    // 확장 패킷은 확장 헤더의 길이만큼 더 읽어야 한다.
+    total += DWP_EXT_HEADER_LENGTH;
+    length = recv(fd, packetArray, total, MSG_PEEK | MSG_WAITALL);
+    if (length < total) {
+      return -1;
+    }
+    memcpy(&ext, packetArray + total - DWP_EXT_HEADER_LENGTH, sizeof(ext));
+    if (ext.length > DWP_EXT_BODY_LENGTH) {
+      return -1;
+    }
+    total += ext.length;
+  }
+  if (total > DWP_HEADER_LENGTH) {
+    length = recv(fd, packetArray, total, MSG_PEEK | MSG_WAITALL);
+    if (length < total) {
+      return -1;
+    }
+  }
+  length = recv(fd, packetArray, total, 0);
+  if (length < total) {
     return -1;
   }
 
   length = dwp_to_struct(packetArray, packet);
+  TRACE_PROBE3(packet_recv, fd, data.qr, data.type);
 
   return length;
 }
@@ -254,9 +492,23 @@ int dwp_copy(dwp_packet* dest, const dwp_packet* src)
   if (dest->challenge == NULL) {
     return -1;
   }
-  strncpy(dest->challenge, src->challenge, bodylen);
+  if (bodylen > 0) {
+    strncpy(dest->challenge, src->challenge, bodylen);
+  }
   dest->challenge[bodylen] = '\0';
 
+  // 확장 바디를 복사한다.
+  free(dest->extBody);
+  dest->ext = src->ext;
+  dest->extBody = NULL;
+  if (src->data.type == DWP_TYPE_EXT && src->ext.length > 0) {
+    dest->extBody = (char*)malloc(src->ext.length);
+    if (dest->extBody == NULL) {
+      return -1;
+    }
+    memcpy(dest->extBody, src->extBody, src->ext.length);
+  }
+
   return 0;
 }
 
@@ -272,6 +524,10 @@ int dwp_destroy(dwp_packet* packet)
     free(packet->challenge);
     packet->challenge = NULL;
   }
+  if (packet->extBody != NULL) {
+    free(packet->extBody);
+    packet->extBody = NULL;
+  }
   
   return 0;
 }
\ No newline at end of file
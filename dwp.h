@@ -6,15 +6,32 @@
 #include <string.h>
 #include <sys/socket.h>
 
-#define DWP_HEADER_LENGTH 10
-#define DWP_BODY_LENGTH 127
-#define DWP_LENGTH (DWP_HEADER_LENGTH + DWP_BODY_LENGTH)
-#define DWP_QR_REQUEST 0
-#define DWP_QR_RESPONSE 1
-#define DWP_TYPE_WORK 0
-#define DWP_TYPE_STOP 1
-#define DWP_TYPE_SUCCESS 0
-#define DWP_TYPE_FAIL 1
+#define DWP_HEADER_LENGTH 10  // DWP 패킷 헤더 길이
+#define DWP_BODY_LENGTH 127 // DWP 패킷 바디 최대 길이
+#define DWP_LENGTH (DWP_HEADER_LENGTH + DWP_BODY_LENGTH)  // DWP 패킷 최대 길이
+#define DWP_QR_REQUEST 0  // DWP 패킷 QR-요청 필드
+#define DWP_QR_RESPONSE 1 // DWP 패킷 QR-응답 필드
+#define DWP_TYPE_WORK 0 // DWP 패킷 Type-작업요청 필드
+#define DWP_TYPE_STOP 1 // DWP 패킷 Type-중단요청 필드
+#define DWP_TYPE_SUCCESS 0  // DWP 패킷 Type-성공 필드
+#define DWP_TYPE_FAIL 1 // DWP 패킷 Type-실패 필드
+#define DWP_TYPE_EXT 2  // DWP 패킷 Type-확장 필드 (요청/응답 공통, 확장 헤더와 확장 바디가 뒤따른다)
+#define DWP_EXT_JOB 0 // 확장 요청: 작업 옵션이 포함된 작업 할당
+#define DWP_EXT_PROGRESS 1  // 확장 응답: 진행 상황 보고
+#define DWP_EXT_RESULTS 2 // 확장 응답: 여러 정답을 묶은 결과 보고
+#define DWP_EXT_SHARES 3  // 확장 응답: share 난이도를 만족하는 nonce들을 묶은 보고
+#define DWP_EXT_REJECT 4  // 확장 응답: 탐색하지 못하고 돌려주는 범위 (nonce, workload에 범위를 담는다)
+#define DWP_MODE_FIRST 0  // 탐색 모드: 첫 정답에서 중단
+#define DWP_MODE_ALL 1  // 탐색 모드: 범위 안의 모든 정답 수집
+#define DWP_MODE_TOPK 2 // 탐색 모드: 해시값이 가장 작은 k개의 정답 수집
+#define DWP_RESULT_BATCH 32 // 결과 보고 패킷 하나에 담는 최대 정답 수
+#define DWP_RESULT_LIMIT_MAX 65536  // 상위 k개 모드에서 수집할 수 있는 최대 정답 수
+#define DWP_SHARE_BATCH 64  // share 보고 패킷 하나에 담는 최대 nonce 수
+#define DWP_SHARE_DIFFICULTY_MIN 5 // share 난이도의 하한. 평균 16^5(약 100만) 번의 해시마다 share 하나가 나온다
+#define DWP_EXT_HEADER_LENGTH 8 // DWP 확장 헤더 길이
+#define DWP_EXT_BODY_LENGTH 4096  // DWP 확장 바디 최대 길이
+#define DWP_MAX_LENGTH (DWP_LENGTH + DWP_EXT_HEADER_LENGTH + DWP_EXT_BODY_LENGTH) // 확장 패킷을 포함한 최대 길이
+#define DWP_BATCH_MAX 16  // 한 번의 벡터 쓰기로 묶어 보낼 수 있는 최대 패킷 수
 
 typedef struct _DWP_Header_Data {
   unsigned short qr : 1;
@@ -23,27 +40,68 @@ typedef struct _DWP_Header_Data {
   unsigned short bodylen : 7;
 } dwp_header_data;
 
+typedef struct _DWP_Ext_Header {
+  unsigned char kind;     // 확장 패킷 종류 (DWP_EXT_*)
+  unsigned char param;    // 종류별 부가 파라미터
+  unsigned short count;   // 종류별 항목 수
+  unsigned int length;    // 확장 바디 길이
+} dwp_ext_header;
+
 typedef struct _DWP_Packet {
   dwp_header_data data;
   unsigned int nonce;
   unsigned int workload;
   char* challenge;
+  dwp_ext_header ext;     // type이 DWP_TYPE_EXT인 경우에만 사용
+  char* extBody;
 } dwp_packet;
 
+// DWP_EXT_JOB 확장 바디
+typedef struct _DWP_Job_Option {
+  unsigned int shardIndex;        // 작업서버 번호
+  unsigned int shardCount;        // 전체 작업서버 수. 0이면 [nonce, nonce + workload) 범위 작업
+  unsigned int progressInterval;  // 진행 상황을 보고할 청크 주기
+  unsigned int searchMode;        // 탐색 모드 (DWP_MODE_*)
+  unsigned int resultLimit;       // DWP_MODE_TOPK에서 수집할 정답 수
+  unsigned int searchEnd;         // 분할 모드의 탐색 종료 nonce. 0이면 nonce 공간 끝까지
+  unsigned int prefixLength;      // midstate에 반영된 챌린지 앞부분의 길이. 0이면 바디의 챌린지가 챌린지 전체
+  unsigned int midstate[8];       // 챌린지 앞부분(64바이트 블록 단위)의 SHA-256 중간 상태. 바디에는 나머지 꼬리만 담는다
+  unsigned int hashAlgorithm;     // 해시 알고리즘 (POW_HASH_*). 0이면 SHA-256
+  unsigned int shareDifficulty;   // 첫 정답 모드에서 share로 보고할 낮은 난이도. 0이면 share를 보고하지 않는다
+} dwp_job_option;
+
+// DWP_EXT_RESULTS 확장 바디의 항목
+typedef struct _DWP_Result {
+  unsigned int nonce;
+  char hash[64];  // 16진수 해시 문자열 ('\0' 제외)
+} dwp_result;
+
 int dwp_create_req(int difficulty, unsigned int workload, const char* challenge, int bodylen, dwp_packet* packet);
 
 int dwp_create_res(int difficulty, unsigned int nonce, unsigned int workload, const char* challenge, int bodylen, dwp_packet* packet);
 
+int dwp_create_stop(int qr, dwp_packet* packet);
+
+int dwp_create_ext(int qr, int kind, unsigned int nonce, unsigned int workload, const void* body, int length, dwp_packet* packet);
+
+int dwp_set_ext(dwp_packet* packet, int kind, int count, const void* body, int length);
+
+int dwp_get_ext(const dwp_packet* packet, void* body, int length);
+
+int dwp_compare_result(const void* a, const void* b);
+
 int dwp_to_arraybuffer(const dwp_packet* packet, char* buffer);
 
 int dwp_to_struct(const char* buffer, dwp_packet* packet);
 
 int dwp_send(int fd, int qr, int type, const dwp_packet* packet);
 
+int dwp_send_batch(int fd, const dwp_packet* packets, int count);
+
 int dwp_recv(int fd, dwp_packet* packet);
 
 int dwp_copy(dwp_packet* dest, const dwp_packet* src);
 
 int dwp_destroy(dwp_packet* packet);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,512 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include "dispatcher.h"
+
+// 메인서버의 작업 분배 정책을 가상 작업서버 수천 대에 대해 이산 사건(discrete-event) 방식으로 재현하는 시뮬레이터이다.
+// 범위 분배와 응답 처리 정책은 메인서버와 같은 dispatcher.c의 함수를 그대로 호출한다.
+//  - 초기 분배: 작업서버마다 DISPATCHER_PREFETCH_DEPTH개의 범위 (assignInitialWork, dispatcher_next)
+//  - 실패 응답: dispatcher_on_fail이 정한 대로 같은 작업서버에 다음 범위 하나, 또는 중단 (finishRange, nextWork)
+//  - 성공 응답: dispatcher_on_success가 채택한 첫 정답이면 모든 작업서버에 중단 요청 (broadcastStop)
+// 메인서버 CPU 시간은 응답 하나의 처리(공통 함수 호출과 그에 따른 작업/중단 요청 전송)와 초기 분배를 각각 한 번씩 재고,
+// 미리 잰 시간 측정 자체의 비용을 뺀다. 실제 메인서버의 소켓 송수신과 잠금 비용은 포함하지 않는다.
+// 장애로 범위를 잃으면 실제 메인서버는 그 범위의 응답을 끝없이 기다리므로, 사건이 바닥나면 멈춘 것(stalled)으로 보고한다.
+// 실제 해시는 계산하지 않는다. nonce마다 정답일 확률이 16^-난이도인 것으로 보고, 범위 안의 첫 정답 위치를 기하분포에서 뽑는다.
+
+#define WORKER_QUEUE_SIZE 16  // 작업서버가 미리 받아 둘 수 있는 범위 수 (working_server의 WORK_QUEUE_SIZE)
+
+#define EVENT_WORK_ARRIVE 0   // 작업 요청이 작업서버에 도착
+#define EVENT_RANGE_END 1     // 작업서버가 범위 탐색을 마침 (정답 발견, 범위 소진, 장애)
+#define EVENT_STOP_ARRIVE 2   // 중단 요청이 작업서버에 도착
+#define EVENT_COORD_ARRIVE 3  // 응답이 메인서버에 도착
+#define EVENT_COORD_HANDLE 4  // 메인서버가 응답 처리를 마침
+
+#define MESSAGE_SUCCESS 0
+#define MESSAGE_FAIL 1
+
+typedef struct {
+  double time;
+  unsigned long long seq;   // 같은 시각의 사건은 만들어진 순서대로 처리한다
+  int type;                 // EVENT_*
+  int worker;
+  int message;              // MESSAGE_* (메인서버로 가는 응답)
+  unsigned int start;
+  unsigned int length;
+} Event;
+
+typedef struct {
+  double rate;              // 초당 해시 수
+  unsigned int queueStart[WORKER_QUEUE_SIZE];
+  unsigned int queueLength[WORKER_QUEUE_SIZE];
+  int queueHead;
+  int queueCount;
+  bool isBusy;
+  bool isStopped;           // 중단 요청을 받음
+  bool isDead;              // 장애로 멈춤. 이후 아무 응답도 보내지 않는다
+  unsigned int start;       // 탐색 중인 범위
+  unsigned int length;
+  double segmentStart;      // 탐색 중인 범위를 시작한 시각
+} Worker;
+
+typedef struct {
+  int workerCount;
+  int difficulty;
+  unsigned int workload;
+  unsigned long long searchEnd;
+  double rate;              // 작업서버의 평균 초당 해시 수
+  double rateSpread;        // 작업서버별 해시 속도의 편차 비율 (균등 분포 ±)
+  double latency;           // 단방향 기본 지연 (초)
+  double jitter;            // 지연에 더해지는 지수 분포의 평균 (초)
+  double failure;           // 범위마다 작업서버에 장애가 날 확률
+  double serviceTime;       // 메인서버가 응답 하나를 처리하는 가상 시간 (초)
+} SimConfig;
+
+typedef struct {
+  bool isSolved;
+  bool isStalled;           // 정답 없이 사건이 바닥났지만 완료되지 않은 범위가 남음 (실제 메인서버는 멈춘다)
+  double solveTime;         // 메인서버가 첫 정답을 받은 시각
+  double endTime;           // 마지막 사건의 시각
+  double totalHashes;
+  double wastedHashes;      // 정답을 받은 뒤 작업서버들이 중단 요청을 받기까지 계산한 해시 수
+  unsigned long long handled;   // 메인서버가 처리한 응답 수
+  unsigned long long sent;      // 메인서버가 보낸 요청 수 (작업, 중단)
+  unsigned long long lostRanges;  // 장애로 완료되지 못한 범위 수
+  double coordinatorCpu;    // 메인서버의 분배와 응답 처리에 쓴 CPU 시간 (초). 시간 측정 비용은 뺀다
+} SimResult;
+
+static Event* events = NULL;  // 시각 순 최소 힙
+static int eventCount = 0;
+static int eventCapacity = 0;
+static unsigned long long eventSeq = 0;
+static unsigned long long randomState = 0x9E3779B97F4A7C15ULL;
+
+static Worker* workers = NULL;
+static dispatcher ranges;
+static double coordinatorFree;  // 메인서버가 다음 응답을 처리할 수 있는 시각
+static double timerCost = 0;    // 시간 측정 한 번에 드는 CPU 시간 (초)
+
+/**
+ * @brief xorshift64* 난수로 (0, 1) 구간의 실수를 반환하는 함수이다.
+ */
+static double randomUnit()
+{
+  randomState ^= randomState >> 12;
+  randomState ^= randomState << 25;
+  randomState ^= randomState >> 27;
+  return (((randomState * 2685821657736338717ULL) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double randomLatency(const SimConfig* config)
+{
+  return config->latency - config->jitter * log(randomUnit());
+}
+
+static bool eventBefore(const Event* a, const Event* b)
+{
+  return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void pushEvent(double time, int type, int worker, int message, unsigned int start, unsigned int length)
+{
+  if (eventCount == eventCapacity) {
+    eventCapacity = eventCapacity > 0 ? eventCapacity * 2 : 1024;
+    events = (Event*)realloc(events, eventCapacity * sizeof(Event));
+    if (events == NULL) {
+      fprintf(stderr, "## Out of memory.\n");
+      exit(-1);
+    }
+  }
+  Event event = { time, eventSeq++, type, worker, message, start, length };
+  int pos = eventCount++;
+  while (pos > 0 && eventBefore(&event, &events[(pos - 1) / 2])) {
+    events[pos] = events[(pos - 1) / 2];
+    pos = (pos - 1) / 2;
+  }
+  events[pos] = event;
+}
+
+static Event popEvent()
+{
+  Event top = events[0];
+  Event last = events[--eventCount];
+  int pos = 0;
+  while (true) {
+    int child = pos * 2 + 1;
+    if (child >= eventCount) {
+      break;
+    }
+    if (child + 1 < eventCount && eventBefore(&events[child + 1], &events[child])) {
+      child++;
+    }
+    if (!eventBefore(&events[child], &last)) {
+      break;
+    }
+    events[pos] = events[child];
+    pos = child;
+  }
+  events[pos] = last;
+  return top;
+}
+
+static double threadCpuTime()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 빈 구간을 잴 때 나오는 시간(시간 측정 자체의 비용)을 미리 재는 함수이다.
+ */
+static void calibrateTimer()
+{
+  const int rounds = 100000;
+  double start = threadCpuTime();
+  for (int i = 0; i < rounds; i++) {
+    threadCpuTime();
+  }
+  timerCost = (threadCpuTime() - start) / (rounds + 1);
+}
+
+/**
+ * @brief cpuStart부터 지금까지의 CPU 시간에서 시간 측정 비용을 빼어 메인서버 CPU 시간에 더하는 함수이다.
+ */
+static void addCoordinatorCpu(double cpuStart, SimResult* result)
+{
+  double elapsed = threadCpuTime() - cpuStart - timerCost;
+  result->coordinatorCpu += elapsed > 0 ? elapsed : 0;
+}
+
+/**
+ * @brief 작업서버의 현재 범위 중 [from, to) 동안 계산한 해시 수를 집계하는 함수이다.
+ * 메인서버가 정답을 받은 뒤에 계산한 부분은 낭비된 해시로 따로 센다.
+ */
+static void countHashes(const Worker* worker, double from, double to, SimResult* result)
+{
+  result->totalHashes += worker->rate * (to - from);
+  if (result->isSolved && to > result->solveTime) {
+    result->wastedHashes += worker->rate * (to - (from > result->solveTime ? from : result->solveTime));
+  }
+}
+
+/**
+ * @brief 작업서버가 큐의 다음 범위 탐색을 시작하는 함수이다.
+ * 범위 안의 첫 정답 위치와 장애 시점을 미리 뽑아, 셋 중 가장 먼저 오는 시점에 범위 종료 사건을 만든다.
+ */
+static void startRange(const SimConfig* config, int index, double now)
+{
+  Worker* worker = &workers[index];
+  if (worker->queueCount == 0) {
+    worker->isBusy = false;
+    return;
+  }
+  worker->start = worker->queueStart[worker->queueHead];
+  worker->length = worker->queueLength[worker->queueHead];
+  worker->queueHead = (worker->queueHead + 1) % WORKER_QUEUE_SIZE;
+  worker->queueCount--;
+  worker->isBusy = true;
+  worker->segmentStart = now;
+
+  // 첫 정답까지의 해시 수는 성공 확률이 16^-난이도인 기하분포를 따른다.
+  double hashes = worker->length;
+  int message = MESSAGE_FAIL;
+  double hit = ceil(log(randomUnit()) / log1p(-pow(16, -config->difficulty)));
+  if (hit <= hashes) {
+    hashes = hit;
+    message = MESSAGE_SUCCESS;
+  }
+  if (config->failure > 0 && randomUnit() < config->failure) {
+    double crash = floor(randomUnit() * worker->length);
+    if (crash < hashes) {
+      hashes = crash;
+      message = -1;
+    }
+  }
+  pushEvent(now + hashes / worker->rate, EVENT_RANGE_END, index, message, worker->start, worker->length);
+}
+
+/**
+ * @brief 메인서버가 작업서버에 범위 하나를 할당하여 보내는 함수이다 (nextWork).
+ */
+static bool sendNextWork(const SimConfig* config, int index, double now, SimResult* result)
+{
+  unsigned int start, length;
+  if (!dispatcher_next(&ranges, &start, &length)) {
+    return false;
+  }
+  pushEvent(now + randomLatency(config), EVENT_WORK_ARRIVE, index, 0, start, length);
+  result->sent++;
+  return true;
+}
+
+/**
+ * @brief 메인서버가 모든 작업서버에 중단 요청을 보내는 함수이다 (broadcastStop).
+ */
+static void broadcastStop(const SimConfig* config, double now, SimResult* result)
+{
+  for (int i = 0; i < config->workerCount; i++) {
+    pushEvent(now + randomLatency(config), EVENT_STOP_ARRIVE, i, 0, 0, 0);
+    result->sent++;
+  }
+}
+
+/**
+ * @brief 메인서버가 작업서버의 응답 하나를 처리하는 함수이다 (client_module).
+ */
+static void handleResponse(const SimConfig* config, const Event* event, SimResult* result)
+{
+  int action;
+  result->handled++;
+
+  // 응답 하나의 처리 전체(정책 결정, 다음 범위 할당, 중단 요청 전송)를 한 번에 잰다.
+  double cpuStart = threadCpuTime();
+  if (event->message == MESSAGE_SUCCESS) {
+    // 실제 nonce는 만들지 않으므로 정답이 든 범위의 시작을 정답으로 넘긴다.
+    action = dispatcher_on_success(&ranges, event->start);
+  }
+  else {
+    action = dispatcher_on_fail(&ranges, event->start, event->length);
+  }
+  if (action == DISPATCHER_ACTION_STOP) {
+    broadcastStop(config, event->time, result);
+  }
+  else if (action == DISPATCHER_ACTION_NEXT) {
+    sendNextWork(config, event->worker, event->time, result);
+  }
+  addCoordinatorCpu(cpuStart, result);
+
+  if (action == DISPATCHER_ACTION_STOP && event->message == MESSAGE_SUCCESS) {
+    result->isSolved = true;
+    result->solveTime = event->time;
+  }
+}
+
+/**
+ * @brief 시뮬레이션 한 번을 실행하는 함수이다.
+ */
+static void runTrial(const SimConfig* config, SimResult* result)
+{
+  memset(result, 0, sizeof(*result));
+  memset(workers, 0, config->workerCount * sizeof(Worker));
+  for (int i = 0; i < config->workerCount; i++) {
+    workers[i].rate = config->rate * (1 + config->rateSpread * (2 * randomUnit() - 1));
+    if (workers[i].rate < 1) {
+      workers[i].rate = 1;
+    }
+  }
+  eventCount = 0;
+  coordinatorFree = 0;
+  dispatcher_init(&ranges, config->workload, 0, config->searchEnd);
+
+  // 모든 작업서버에 초기 작업을 분배한다 (assignInitialWork).
+  double cpuStart = threadCpuTime();
+  for (int i = 0; i < config->workerCount; i++) {
+    for (int j = 0; j < DISPATCHER_PREFETCH_DEPTH; j++) {
+      if (!sendNextWork(config, i, 0, result)) {
+        break;
+      }
+    }
+  }
+  addCoordinatorCpu(cpuStart, result);
+
+  while (eventCount > 0) {
+    Event event = popEvent();
+    Worker* worker = &workers[event.worker];
+    result->endTime = event.time;
+
+    switch (event.type) {
+      case EVENT_WORK_ARRIVE:
+        // 멈춘 작업서버에 도착한 범위는 완료되지 못한다. 중단한 작업서버의 범위는 작업이 끝났으므로 잃은 것이 아니다.
+        if (worker->isDead) {
+          result->lostRanges++;
+          break;
+        }
+        if (worker->isStopped) {
+          break;
+        }
+        if (worker->queueCount == WORKER_QUEUE_SIZE) {
+          result->lostRanges++;
+          break;
+        }
+        worker->queueStart[(worker->queueHead + worker->queueCount) % WORKER_QUEUE_SIZE] = event.start;
+        worker->queueLength[(worker->queueHead + worker->queueCount) % WORKER_QUEUE_SIZE] = event.length;
+        worker->queueCount++;
+        if (!worker->isBusy) {
+          startRange(config, event.worker, event.time);
+        }
+        break;
+      case EVENT_RANGE_END:
+        // 중단 요청을 받아 이미 멈춘 범위의 종료 사건은 무시한다.
+        if (worker->isStopped) {
+          break;
+        }
+        countHashes(worker, worker->segmentStart, event.time, result);
+        if (event.message < 0) {
+          worker->isDead = true;
+          worker->isBusy = false;
+          result->lostRanges += 1 + worker->queueCount;
+          break;
+        }
+        pushEvent(event.time + randomLatency(config), EVENT_COORD_ARRIVE, event.worker, event.message, event.start, event.length);
+        // 성공 응답을 보낸 작업서버도 중단 요청을 받기 전까지는 큐의 다음 범위를 탐색한다.
+        startRange(config, event.worker, event.time);
+        break;
+      case EVENT_STOP_ARRIVE:
+        if (worker->isDead || worker->isStopped) {
+          break;
+        }
+        if (worker->isBusy) {
+          countHashes(worker, worker->segmentStart, event.time, result);
+        }
+        worker->isStopped = true;
+        worker->isBusy = false;
+        break;
+      case EVENT_COORD_ARRIVE: {
+        // 메인서버는 응답을 하나씩 처리하므로, 처리 시간이 있으면 도착한 순서대로 기다린다.
+        double done = (event.time > coordinatorFree ? event.time : coordinatorFree) + config->serviceTime;
+        coordinatorFree = done;
+        pushEvent(done, EVENT_COORD_HANDLE, event.worker, event.message, event.start, event.length);
+        break;
+      }
+      case EVENT_COORD_HANDLE:
+        handleResponse(config, &event, result);
+        break;
+    }
+  }
+  result->isStalled = !result->isSolved && !dispatcher_is_done(&ranges);
+  dispatcher_destroy(&ranges, false);
+}
+
+int main(int argc, char** argv)
+{
+  // 옵션을 처리한다.
+  //  -n workers : 가상 작업서버 수
+  //  -d difficulty : 난이도
+  //  -w workload : 범위 하나의 크기
+  //  -e end : 탐색 종료 nonce
+  //  -r rate : 작업서버의 평균 초당 해시 수
+  //  -v spread : 작업서버별 해시 속도 편차 비율 (0.2이면 평균의 ±20%)
+  //  -l latency : 단방향 기본 지연 (ms)
+  //  -j jitter : 지연에 더해지는 지수 분포의 평균 (ms)
+  //  -f failure : 범위마다 작업서버에 장애가 날 확률
+  //  -c service : 메인서버가 응답 하나를 처리하는 가상 시간 (us)
+  //  -t trials : 반복 횟수
+  //  -s seed : 난수 시드
+  const char* usage = ">> usage: fleet_sim [-n workers] [-d difficulty] [-w workload] [-e end] [-r rate] [-v spread] [-l latency_ms] [-j jitter_ms] [-f failure] [-c service_us] [-t trials] [-s seed]\n";
+  SimConfig config = { 1000, 7, 100000, 0x100000000ULL, 1e7, 0.2, 0.001, 0.0005, 0, 0 };
+  int trials = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:d:w:e:r:v:l:j:f:c:t:s:")) != -1) {
+    switch (opt) {
+      case 'n':
+        config.workerCount = atoi(optarg);
+        break;
+      case 'd':
+        config.difficulty = atoi(optarg);
+        break;
+      case 'w':
+        config.workload = strtoul(optarg, NULL, 10);
+        break;
+      case 'e':
+        config.searchEnd = strtoull(optarg, NULL, 10);
+        break;
+      case 'r':
+        config.rate = atof(optarg);
+        break;
+      case 'v':
+        config.rateSpread = atof(optarg);
+        break;
+      case 'l':
+        config.latency = atof(optarg) / 1e3;
+        break;
+      case 'j':
+        config.jitter = atof(optarg) / 1e3;
+        break;
+      case 'f':
+        config.failure = atof(optarg);
+        break;
+      case 'c':
+        config.serviceTime = atof(optarg) / 1e6;
+        break;
+      case 't':
+        trials = atoi(optarg);
+        break;
+      case 's':
+        randomState = strtoull(optarg, NULL, 10) * 0x9E3779B97F4A7C15ULL + 1;
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return -1;
+    }
+  }
+  if (config.workerCount <= 0 || config.difficulty <= 0 || config.workload == 0 || config.rate <= 0 || trials <= 0
+      || config.searchEnd == 0 || config.searchEnd > 0x100000000ULL) {
+    fprintf(stderr, "%s", usage);
+    return -1;
+  }
+
+  workers = (Worker*)malloc(config.workerCount * sizeof(Worker));
+  if (workers == NULL) {
+    fprintf(stderr, "## Out of memory.\n");
+    return -1;
+  }
+
+  printf(">> %d workers, difficulty %d, workload %u, %.3g hashes/sec (±%.0f%%), latency %.3g+%.3g ms, failure %g, service %.3g us\n",
+    config.workerCount, config.difficulty, config.workload, config.rate, config.rateSpread * 100,
+    config.latency * 1e3, config.jitter * 1e3, config.failure, config.serviceTime * 1e6);
+
+  calibrateTimer();
+  int solved = 0, stalled = 0;
+  double solveSum = 0, solveMin = 0, solveMax = 0;
+  double wastedSum = 0, totalSum = 0, cpuSum = 0;
+  unsigned long long handledSum = 0, sentSum = 0, lostSum = 0;
+  for (int i = 0; i < trials; i++) {
+    SimResult result;
+    runTrial(&config, &result);
+    // 모든 응답과 요청은 시간을 잰 구간 안에서 처리되므로, 메시지 하나의 CPU 시간은 둘을 합한 수로 나눈다.
+    printf(">> #%d %s in %.4f sec, %.4g hashes, %.4g wasted after solve, %llu responses, %llu requests, %llu lost ranges, %.0f ns/message\n",
+      i, result.isSolved ? "solved" : result.isStalled ? "stalled (lost ranges are never completed)" : "exhausted", result.isSolved ? result.solveTime : result.endTime,
+      result.totalHashes, result.wastedHashes, result.handled, result.sent, result.lostRanges,
+      result.handled + result.sent > 0 ? result.coordinatorCpu / (result.handled + result.sent) * 1e9 : 0.0);
+
+    if (result.isSolved) {
+      solveSum += result.solveTime;
+      solveMin = solved == 0 || result.solveTime < solveMin ? result.solveTime : solveMin;
+      solveMax = solved == 0 || result.solveTime > solveMax ? result.solveTime : solveMax;
+      solved++;
+    }
+    if (result.isStalled) {
+      stalled++;
+    }
+    wastedSum += result.wastedHashes;
+    totalSum += result.totalHashes;
+    cpuSum += result.coordinatorCpu;
+    handledSum += result.handled;
+    sentSum += result.sent;
+    lostSum += result.lostRanges;
+  }
+
+  printf(">> Solved: %d/%d\n", solved, trials);
+  if (stalled > 0) {
+    printf(">> Stalled: %d/%d (the coordinator would wait forever for lost ranges)\n", stalled, trials);
+  }
+  if (solved > 0) {
+    printf(">> Time to solve: %.4f sec (min %.4f, max %.4f)\n", solveSum / solved, solveMin, solveMax);
+  }
+  printf(">> Wasted hashes after solve: %.4g per trial (%.2f%% of hashes)\n", wastedSum / trials,
+    totalSum > 0 ? wastedSum / totalSum * 100 : 0.0);
+  printf(">> Messages: %.1f responses, %.1f requests per trial\n", (double)handledSum / trials, (double)sentSum / trials);
+  printf(">> Coordinator CPU (dispatch and response handling, no socket I/O): %.0f ns/message (%.4f sec total)\n",
+    handledSum + sentSum > 0 ? cpuSum / (handledSum + sentSum) * 1e9 : 0.0, cpuSum);
+  if (lostSum > 0) {
+    printf(">> Lost ranges: %.1f per trial\n", (double)lostSum / trials);
+  }
+
+  free(workers);
+  free(events);
+  return 0;
+}
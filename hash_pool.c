@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "cpu_topology.h"
+#include "hash_pool.h"
+#include "perf_trace.h"
+
+#define CACHE_LINE_SIZE 64
+
+// 스레드별 상태. 각 스레드가 CPU에 고정된 뒤 직접 할당하므로(first-touch) 해당 NUMA 노드의 메모리에 놓이고,
+// 캐시 라인 단위로 정렬하여 스레드 사이의 false sharing을 막는다.
+typedef struct {
+  int result;             // 마지막 작업의 findNonce 실행 결과
+  unsigned int nonce;     // 찾은 nonce
+  char hash[65];          // 찾은 nonce의 해시값
+  bool hasCounters;       // 성능 카운터를 열었는지 여부
+  perf_counters counters; // 이 스레드의 하드웨어 성능 카운터
+  perf_sample sample;     // 마지막 작업의 성능 카운터 측정값
+} __attribute__((aligned(CACHE_LINE_SIZE))) ThreadState;
+
+typedef struct {
+  int index;
+  int cpu;
+  pthread_t thread;
+  ThreadState* state;
+} PoolThread;
+
+static PoolThread* threads = NULL;
+static int threadCount = 0;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t startCond = PTHREAD_COND_INITIALIZER;  // 새 작업 시작을 알리는 조건 변수
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;   // 작업 종료를 알리는 조건 변수
+static pthread_mutex_t hitMutex = PTHREAD_MUTEX_INITIALIZER; // 정답 콜백을 직렬화하는 뮤텍스
+static unsigned long generation = 0;  // 작업 세대. 증가하면 스레드들이 새 작업을 시작한다
+static int pending = 0;               // 작업을 끝내지 않은 스레드 수
+static int readyCount = 0;            // 상태 할당을 마친 스레드 수
+static bool isShutdown = false;
+static bool useCounters = false;      // 스레드마다 성능 카운터를 열지 여부
+
+// 현재 작업
+static bool isFindAll;
+static const pow_context* taskContext;
+static int taskDifficulty;
+static unsigned int taskStart;
+static unsigned int taskRange;
+static pow_hit_callback taskOnHit;
+static void* taskArg;
+static int taskSolveDifficulty;       // share 탐색에서 정답으로 인정할 난이도. 0이면 모든 정답 탐색
+static bool isSolved;                 // share 탐색에서 정답을 찾았는지 여부
+static unsigned int solvedNonce;
+static char solvedHash[65];
+static volatile bool taskCancel = false;
+
+static void onHit(unsigned int nonce, const char hash[65], void* arg)
+{
+  pthread_mutex_lock(&hitMutex);
+  // share 탐색에서는 원래 난이도까지 만족하는 share를 정답으로 기록하고 나머지 스레드를 중단시킨다.
+  if (taskSolveDifficulty > 0 && !isSolved && hashDifficulty(hash) >= taskSolveDifficulty) {
+    isSolved = true;
+    solvedNonce = nonce;
+    strcpy(solvedHash, hash);
+    taskCancel = true;
+  }
+  taskOnHit(nonce, hash, arg);
+  pthread_mutex_unlock(&hitMutex);
+}
+
+/**
+ * @brief 해시 스레드 함수이다. 지정된 CPU에 고정한 뒤 작업마다 자신의 몫의 구간을 탐색한다.
+ *
+ * @param arg PoolThread 포인터
+ */
+static void* hashThread(void* arg)
+{
+  PoolThread* self = (PoolThread*)arg;
+  unsigned long seen = 0;
+
+  // CPU에 고정한 뒤에 스레드 상태를 할당해야 노드 로컬 메모리에 놓인다.
+  topology_pin_self(self->cpu);
+  ThreadState* state = (ThreadState*)aligned_alloc(CACHE_LINE_SIZE, sizeof(ThreadState));
+  memset(state, 0, sizeof(*state));
+  if (useCounters) {
+    state->hasCounters = perf_counters_open(&state->counters) == 0;
+  }
+
+  pthread_mutex_lock(&mutex);
+  self->state = state;
+  readyCount++;
+  pthread_cond_broadcast(&doneCond);
+  while (true) {
+    while (!isShutdown && generation == seen) {
+      pthread_cond_wait(&startCond, &mutex);
+    }
+    if (isShutdown) {
+      break;
+    }
+    seen = generation;
+    pthread_mutex_unlock(&mutex);
+
+    // 전체 범위를 스레드 수로 나눈 자신의 몫을 계산한다.
+    unsigned long long begin = taskStart + (unsigned long long)taskRange * self->index / threadCount;
+    unsigned long long end = taskStart + (unsigned long long)taskRange * (self->index + 1) / threadCount;
+
+    if (state->hasCounters) {
+      memset(&state->sample, 0, sizeof(state->sample));
+      perf_counters_start(&state->counters);
+    }
+    if (isFindAll) {
+      state->result = findAllNonces(taskContext, taskDifficulty, begin, end - begin, onHit, taskArg, &taskCancel);
+    }
+    else {
+      state->result = findNonceUntil(&state->nonce, state->hash, taskContext, taskDifficulty, begin, end - begin, &taskCancel);
+      // 먼저 찾은 스레드가 나머지 스레드를 중단시킨다.
+      if (state->result == POW_SUCCESS) {
+        taskCancel = true;
+      }
+    }
+    if (state->hasCounters) {
+      perf_counters_stop(&state->counters, &state->sample);
+    }
+
+    pthread_mutex_lock(&mutex);
+    if (--pending == 0) {
+      pthread_cond_broadcast(&doneCond);
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+
+  if (state->hasCounters) {
+    perf_counters_close(&state->counters);
+  }
+  free(state);
+  return NULL;
+}
+
+int hash_pool_init(int count, const int* cpus, bool counters)
+{
+  if (count <= 0) {
+    count = 1;
+  }
+  useCounters = counters;
+  threads = (PoolThread*)calloc(count, sizeof(PoolThread));
+  if (threads == NULL) {
+    return -1;
+  }
+  threadCount = count;
+
+  for (int i = 0; i < count; i++) {
+    threads[i].index = i;
+    threads[i].cpu = cpus != NULL ? cpus[i] : -1;
+    if (pthread_create(&threads[i].thread, NULL, hashThread, &threads[i]) != 0) {
+      return -1;
+    }
+  }
+
+  // 모든 스레드가 상태 할당을 마칠 때까지 대기한다.
+  pthread_mutex_lock(&mutex);
+  while (readyCount < threadCount) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+  return 0;
+}
+
+/**
+ * @brief 작업을 모든 해시 스레드에 배포하고 끝날 때까지 대기하는 함수이다.
+ */
+static void runTask()
+{
+  pthread_mutex_lock(&mutex);
+  taskCancel = false;
+  pending = threadCount;
+  generation++;
+  pthread_cond_broadcast(&startCond);
+  while (pending > 0) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+int hash_pool_find(unsigned int* nonce, char hashresult[65], const pow_context * context, int difficulty, unsigned int startNonce, unsigned int nonceRange)
+{
+  isFindAll = false;
+  taskContext = context;
+  taskDifficulty = difficulty;
+  taskStart = startNonce;
+  taskRange = nonceRange;
+  runTask();
+
+  for (int i = 0; i < threadCount; i++) {
+    if (threads[i].state->result == POW_SUCCESS) {
+      *nonce = threads[i].state->nonce;
+      strcpy(hashresult, threads[i].state->hash);
+      return POW_SUCCESS;
+    }
+  }
+  *nonce = -1;
+  sprintf(hashresult, "failed");
+  return terminateFindNonce ? POW_TERMINATED : POW_NOTFOUND;
+}
+
+int hash_pool_find_all(const pow_context * context, int difficulty, unsigned int startNonce, unsigned int nonceRange, pow_hit_callback callback, void* arg)
+{
+  isFindAll = true;
+  taskContext = context;
+  taskDifficulty = difficulty;
+  taskStart = startNonce;
+  taskRange = nonceRange;
+  taskOnHit = callback;
+  taskArg = arg;
+  taskSolveDifficulty = 0;
+  runTask();
+
+  if (terminateFindNonce) {
+    return POW_TERMINATED;
+  }
+  for (int i = 0; i < threadCount; i++) {
+    if (threads[i].state->result == POW_SUCCESS) {
+      return POW_SUCCESS;
+    }
+  }
+  return POW_NOTFOUND;
+}
+
+int hash_pool_find_shares(unsigned int* nonce, char hashresult[65], const pow_context * context, int difficulty, int shareDifficulty,
+  unsigned int startNonce, unsigned int nonceRange, pow_hit_callback onShare, void* arg)
+{
+  isFindAll = true;
+  taskContext = context;
+  taskDifficulty = shareDifficulty;
+  taskStart = startNonce;
+  taskRange = nonceRange;
+  taskOnHit = onShare;
+  taskArg = arg;
+  taskSolveDifficulty = difficulty;
+  isSolved = false;
+  runTask();
+
+  if (isSolved) {
+    *nonce = solvedNonce;
+    strcpy(hashresult, solvedHash);
+    return POW_SUCCESS;
+  }
+  *nonce = -1;
+  sprintf(hashresult, "failed");
+  return terminateFindNonce ? POW_TERMINATED : POW_NOTFOUND;
+}
+
+bool hash_pool_sample(perf_sample* sample)
+{
+  bool hasCounters = false;
+  memset(sample, 0, sizeof(*sample));
+  for (int i = 0; i < threadCount; i++) {
+    if (threads[i].state->hasCounters) {
+      sample->cycles += threads[i].state->sample.cycles;
+      sample->instructions += threads[i].state->sample.instructions;
+      sample->branchMisses += threads[i].state->sample.branchMisses;
+      hasCounters = true;
+    }
+  }
+  return hasCounters;
+}
+
+int hash_pool_size()
+{
+  return threadCount;
+}
+
+void hash_pool_destroy()
+{
+  pthread_mutex_lock(&mutex);
+  isShutdown = true;
+  pthread_cond_broadcast(&startCond);
+  pthread_mutex_unlock(&mutex);
+
+  for (int i = 0; i < threadCount; i++) {
+    pthread_join(threads[i].thread, NULL);
+  }
+  free(threads);
+  threads = NULL;
+  threadCount = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef HASH_POOL_H
+#define HASH_POOL_H
+
+#include <stdbool.h>
+#include "proof_of_work.h"
+#include "perf_trace.h"
+
+/// @brief 해시 스레드 풀을 생성한다
+/// @param threadCount 해시 스레드 수
+/// @param cpus 스레드별로 고정할 CPU 번호 배열. NULL이거나 값이 음수이면 고정하지 않는다
+/// @param counters 스레드마다 하드웨어 성능 카운터를 열어 작업마다 측정할지 여부
+/// @return 성공 시 0
+int hash_pool_init(int threadCount, const int* cpus, bool counters);
+
+/// @brief 범위를 해시 스레드 수만큼 나누어 난이도에 맞는 nonce를 찾는다
+/// 한 스레드가 nonce를 찾으면 나머지 스레드는 즉시 중단된다.
+/// @return findNonce와 같다
+int hash_pool_find(unsigned int* nonce, char hashresult[65], const pow_context * context, int difficulty, unsigned int startNonce, unsigned int nonceRange);
+
+/// @brief 범위를 해시 스레드 수만큼 나누어 난이도에 맞는 모든 nonce를 찾는다
+/// 콜백은 한 번에 한 스레드에서만 호출된다.
+/// @return findAllNonces와 같다
+int hash_pool_find_all(const pow_context * context, int difficulty, unsigned int startNonce, unsigned int nonceRange, pow_hit_callback onHit, void* arg);
+
+/// @brief 범위를 해시 스레드 수만큼 나누어 낮은 난이도(share)를 만족하는 nonce를 모두 콜백으로 전달하면서,
+/// 원래 난이도를 만족하는 nonce를 찾으면 나머지 스레드를 중단한다. 정답도 share로 전달된다.
+/// 콜백은 한 번에 한 스레드에서만 호출된다.
+/// @param difficulty 원래 난이도
+/// @param shareDifficulty share 난이도. difficulty보다 작아야 한다
+/// @return findNonce와 같다
+int hash_pool_find_shares(unsigned int* nonce, char hashresult[65], const pow_context * context, int difficulty, int shareDifficulty,
+  unsigned int startNonce, unsigned int nonceRange, pow_hit_callback onShare, void* arg);
+
+/// @brief 마지막 작업에서 모든 해시 스레드가 측정한 성능 카운터 값의 합을 구한다
+/// @param sample 측정값 합
+/// @return 성능 카운터를 연 스레드가 없으면 false
+bool hash_pool_sample(perf_sample* sample);
+
+/// @brief 해시 스레드 풀의 스레드 수를 반환한다
+int hash_pool_size();
+
+/// @brief 해시 스레드를 종료하고 자원을 반환한다
+void hash_pool_destroy();
+
+#endif
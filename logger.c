@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "logger.h"
+
+#define DRAIN_INTERVAL_NS 1000000 // 출력할 로그가 없을 때 출력 스레드가 쉬는 시간 (1ms)
+
+typedef struct {
+  unsigned long long seq;   // 모든 스레드에 걸친 로그 순서 (항목을 게시하기 전에 정해진다)
+  int level;
+  char message[LOG_MESSAGE_LENGTH];
+} LogEntry;
+
+// 스레드 하나가 쓰고 출력 스레드 하나가 읽는 단일 생산자/단일 소비자 링 버퍼.
+// head는 생산자만, tail은 소비자만 갱신하므로 잠금 없이 원자적 읽기/쓰기만으로 동기화된다.
+typedef struct LogRing {
+  LogEntry entries[LOG_RING_SIZE];
+  _Atomic unsigned int head;  // 생산자가 다음에 쓸 위치
+  _Atomic unsigned int tail;  // 소비자가 다음에 읽을 위치
+  _Atomic unsigned long long dropped; // 가득 차거나 속도 제한에 걸려 버린 로그 수
+  time_t window;              // 속도 제한 구간 (초)
+  unsigned int windowCount;   // 현재 구간에 남긴 로그 수
+  struct LogRing* next;
+} LogRing;
+
+static _Atomic(LogRing*) rings = NULL;  // 등록된 링 버퍼 목록. 스레드가 끝나도 해제하지 않는다
+static pthread_mutex_t registerMutex = PTHREAD_MUTEX_INITIALIZER;  // 링 버퍼 등록만 직렬화한다
+static __thread LogRing* localRing = NULL;
+static _Atomic unsigned long long sequence = 0;
+static _Atomic bool isRunning = false;
+static _Atomic int minLevel = LOG_MIN_LEVEL;
+static pthread_t drainThread;
+
+static FILE* levelStream(int level)
+{
+  return level >= LOG_LEVEL_WARN ? stderr : stdout;
+}
+
+/**
+ * @brief 호출한 스레드의 링 버퍼를 반환하는 함수이다. 처음 호출할 때 만들어 목록에 등록한다.
+ */
+static LogRing* getRing()
+{
+  if (localRing == NULL) {
+    LogRing* ring = (LogRing*)calloc(1, sizeof(LogRing));
+    if (ring == NULL) {
+      return NULL;
+    }
+    pthread_mutex_lock(&registerMutex);
+    ring->next = atomic_load(&rings);
+    atomic_store_explicit(&rings, ring, memory_order_release);
+    pthread_mutex_unlock(&registerMutex);
+    localRing = ring;
+  }
+  return localRing;
+}
+
+/**
+ * @brief 모든 링 버퍼에서 지금 보이는 로그 중 순서가 가장 앞선 것부터 출력하는 함수이다.
+ * 순서 번호는 항목을 게시하기 전에 정해지므로, 다른 스레드가 아직 게시하지 않은 더 앞선 로그가 나중에 출력될 수 있다.
+ * 따라서 스레드 사이의 출력 순서는 대략적이며, 한 스레드 안의 순서만 보장된다.
+ *
+ * @return int 출력한 로그 수
+ */
+static int drainRings()
+{
+  int written = 0;
+  unsigned long long dropped = 0;
+
+  while (true) {
+    LogRing* oldest = NULL;
+    unsigned long long oldestSeq = 0;
+    for (LogRing* ring = atomic_load_explicit(&rings, memory_order_acquire); ring != NULL; ring = ring->next) {
+      unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+      if (tail == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+        continue;
+      }
+      unsigned long long seq = ring->entries[tail % LOG_RING_SIZE].seq;
+      if (oldest == NULL || seq < oldestSeq) {
+        oldest = ring;
+        oldestSeq = seq;
+      }
+    }
+    if (oldest == NULL) {
+      break;
+    }
+
+    unsigned int tail = atomic_load_explicit(&oldest->tail, memory_order_relaxed);
+    const LogEntry* entry = &oldest->entries[tail % LOG_RING_SIZE];
+    FILE* stream = levelStream(entry->level);
+    fputs(entry->message, stream);
+    fputc('\n', stream);
+    atomic_store_explicit(&oldest->tail, tail + 1, memory_order_release);
+    written++;
+  }
+
+  for (LogRing* ring = atomic_load_explicit(&rings, memory_order_acquire); ring != NULL; ring = ring->next) {
+    dropped += atomic_exchange(&ring->dropped, 0);
+  }
+  if (dropped > 0) {
+    fprintf(stderr, "## %llu log messages dropped\n", dropped);
+  }
+  if (written > 0) {
+    fflush(stdout);
+  }
+  return written;
+}
+
+static void* drainMain(void* arg)
+{
+  struct timespec interval = { 0, DRAIN_INTERVAL_NS };
+  while (atomic_load(&isRunning)) {
+    if (drainRings() == 0) {
+      nanosleep(&interval, NULL);
+    }
+  }
+  drainRings();
+  return NULL;
+}
+
+int log_init()
+{
+  atomic_store(&isRunning, true);
+  if (pthread_create(&drainThread, NULL, drainMain, NULL) != 0) {
+    atomic_store(&isRunning, false);
+    return -1;
+  }
+  return 0;
+}
+
+void log_set_level(int level)
+{
+  atomic_store(&minLevel, level);
+}
+
+void log_write(int level, const char* format, ...)
+{
+  va_list args;
+  if (level < atomic_load_explicit(&minLevel, memory_order_relaxed)) {
+    return;
+  }
+
+  // 출력 스레드가 없으면 바로 출력한다.
+  LogRing* ring = atomic_load_explicit(&isRunning, memory_order_relaxed) ? getRing() : NULL;
+  if (ring == NULL) {
+    FILE* stream = levelStream(level);
+    va_start(args, format);
+    vfprintf(stream, format, args);
+    va_end(args);
+    fputc('\n', stream);
+    return;
+  }
+
+  // 경고보다 낮은 레벨은 스레드마다 1초에 LOG_RATE_LIMIT개까지만 남긴다.
+  if (level < LOG_LEVEL_WARN) {
+    time_t now = time(NULL);
+    if (now != ring->window) {
+      ring->window = now;
+      ring->windowCount = 0;
+    }
+    if (++ring->windowCount > LOG_RATE_LIMIT) {
+      atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+      return;
+    }
+  }
+
+  unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) == LOG_RING_SIZE) {
+    atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    return;
+  }
+  LogEntry* entry = &ring->entries[head % LOG_RING_SIZE];
+  entry->level = level;
+  entry->seq = atomic_fetch_add_explicit(&sequence, 1, memory_order_relaxed);
+  va_start(args, format);
+  vsnprintf(entry->message, sizeof(entry->message), format, args);
+  va_end(args);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void log_flush()
+{
+  struct timespec interval = { 0, DRAIN_INTERVAL_NS };
+  if (!atomic_load(&isRunning)) {
+    fflush(stdout);
+    return;
+  }
+  bool isEmpty = false;
+  while (!isEmpty) {
+    isEmpty = true;
+    for (LogRing* ring = atomic_load_explicit(&rings, memory_order_acquire); ring != NULL; ring = ring->next) {
+      if (atomic_load(&ring->tail) != atomic_load(&ring->head)) {
+        isEmpty = false;
+        nanosleep(&interval, NULL);
+        break;
+      }
+    }
+  }
+  fflush(stdout);
+}
+
+void log_shutdown()
+{
+  if (!atomic_load(&isRunning)) {
+    return;
+  }
+  atomic_store(&isRunning, false);
+  pthread_join(drainThread, NULL);
+  fflush(stdout);
+  fflush(stderr);
+}
@@ -0,0 +1,50 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+
+#define LOG_LEVEL_DEBUG 0 // 패킷, 범위마다 남기는 상세 로그
+#define LOG_LEVEL_INFO 1  // 작업 단위의 진행 상황
+#define LOG_LEVEL_WARN 2  // 잘못된 패킷 등 복구 가능한 오류 (표준 에러로 출력)
+#define LOG_LEVEL_ERROR 3 // 복구할 수 없는 오류 (표준 에러로 출력)
+
+// 이보다 낮은 레벨의 로그 호출은 컴파일 시 제거된다. 예: make CFLAGS="-O2 -DLOG_MIN_LEVEL=0"
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SIZE 1024        // 스레드별 링 버퍼의 항목 수 (2의 거듭제곱)
+#define LOG_MESSAGE_LENGTH 240    // 로그 메시지 하나의 최대 길이
+#define LOG_RATE_LIMIT 1000       // 스레드마다 1초에 남길 수 있는 INFO 이하 로그 수. 넘으면 버리고 개수만 센다
+
+// 레벨 비교는 상수식이므로 LOG_MIN_LEVEL보다 낮은 호출은 컴파일러가 제거하며, 인자의 타입 검사는 그대로 받는다.
+#define LOG_AT(level, ...) do { \
+    if ((level) >= LOG_MIN_LEVEL) { \
+      log_write((level), __VA_ARGS__); \
+    } \
+  } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+/// @brief 로그 출력 스레드를 시작한다. 시작하기 전의 로그는 호출한 스레드에서 바로 출력된다
+/// @return 성공 시 0
+int log_init();
+
+/// @brief 실행 중에 남길 최소 레벨을 정한다. LOG_MIN_LEVEL보다 낮은 레벨은 이미 제거되어 있다
+void log_set_level(int level);
+
+/// @brief 로그 메시지를 호출한 스레드의 링 버퍼에 넣는다. 버퍼가 가득 차면 기다리지 않고 버린다
+/// @param level 로그 레벨 (LOG_LEVEL_*)
+/// @param format printf 형식 문자열. 줄바꿈은 출력 스레드가 붙인다
+void log_write(int level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+/// @brief 지금까지 넣은 로그가 모두 출력될 때까지 기다린다
+void log_flush();
+
+/// @brief 남은 로그를 모두 출력하고 로그 출력 스레드를 종료한다
+void log_shutdown();
+
+#endif
@@ -4,7 +4,76 @@
 #include <time.h>
 #include "proof_of_work.h"
 
-int main(){
+#define CHECK_MAX_HITS 4096
+
+typedef struct {
+    unsigned int nonces[CHECK_MAX_HITS];
+    char hashes[CHECK_MAX_HITS][65];
+    int count;
+} HitList;
+
+static void onHit(unsigned int nonce, const char hash[65], void* arg){
+    HitList* list = (HitList*)arg;
+    if (list->count < CHECK_MAX_HITS) {
+        list->nonces[list->count] = nonce;
+        strcpy(list->hashes[list->count], hash);
+    }
+    list->count++;
+}
+
+/**
+ * @brief 특화 커널과 범용 탐색 경로가 같은 정답을 찾는지 확인한다.
+ * 챌린지 길이(마지막 블록 수)와 nonce 자릿수가 바뀌는 경계를 지나는 범위를 SHA-256, 이중 SHA-256, BLAKE3로 탐색한다.
+ *
+ * @return int 모두 같으면 0
+ */
+static int checkKernels(){
+    static const unsigned int ranges[][2] = {
+        { 0, 1200 }, { 99990, 20 }, { 999999990, 20 }, { 4294966000u, 1296 },
+    };
+    static HitList generic, kernel;
+    char challenge[200];
+    int failed = 0, cases = 0;
+
+    for (int algorithm = POW_HASH_SHA256; algorithm < POW_HASH_COUNT; algorithm++) {
+        for (int length = 0; length <= 130; length++) {
+            for (int i = 0; i < length; i++) {
+                challenge[i] = 'a' + (i * 7 + length) % 26;
+            }
+            challenge[length] = '\0';
+            pow_context context;
+            pow_context_init(&context, algorithm, challenge, length);
+
+            for (int r = 0; r < (int)(sizeof(ranges) / sizeof(ranges[0])); r++) {
+                int difficulty = ranges[r][1] < 100 ? 1 : 2;
+                generic.count = kernel.count = 0;
+                useSearchKernels = false;
+                findAllNonces(&context, difficulty, ranges[r][0], ranges[r][1], onHit, &generic, NULL);
+                useSearchKernels = true;
+                findAllNonces(&context, difficulty, ranges[r][0], ranges[r][1], onHit, &kernel, NULL);
+
+                bool same = generic.count == kernel.count;
+                for (int i = 0; same && i < generic.count && i < CHECK_MAX_HITS; i++) {
+                    same = generic.nonces[i] == kernel.nonces[i] && strcmp(generic.hashes[i], kernel.hashes[i]) == 0;
+                }
+                if (!same) {
+                    printf("Mismatch: %s, challenge length %d, range [%u..+%u)\n", pow_get_backend(algorithm)->name,
+                        length, ranges[r][0], ranges[r][1]);
+                    failed++;
+                }
+                cases++;
+            }
+        }
+    }
+    printf("Kernel check: %d/%d cases passed\n", cases - failed, cases);
+    return failed > 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[]){
+    if (argc > 1 && strcmp(argv[1], "check") == 0) {
+        return checkKernels();
+    }
+
     char *challenge = "201928332019283620192873";
     char sha256Hash[65];
     unsigned int nonce;
@@ -14,25 +14,105 @@
 #include <fcntl.h>
 #include <time.h>
 #include "dwp.h"
+#include "proof_of_work.h"
+#include "result_cache.h"
+#include "dispatcher.h"
+#include "perf_trace.h"
+#include "logger.h"
+#include <openssl/sha.h>
 
 #define ISVALIDSOCKET(s) ((s) >= 0)
 #define CLOSESOCKET(s) close(s)
 #define SOCKET int
 #define NUM_WORKING_SERVER 2
 #define MAX_INPUT_LENGTH 1000
+#define DEFAULT_PROGRESS_INTERVAL 16  // 분할 모드에서 진행 상황을 보고할 기본 청크 주기
+#define DEFAULT_CACHE_PATH "pow_cache.db" // 기본 정답 캐시 파일 경로
+#define DEFAULT_CHECKPOINT_DIR "." // 기본 체크포인트 로그 디렉터리
+
+typedef struct {
+  SOCKET socket;
+  int index;  // workerStats의 번호
+} ThreadParams;
+
+#define WORKER_OPEN_RANGES (DWP_BATCH_MAX + 1) // 작업서버 하나가 동시에 가질 수 있는 범위 수 (작업 큐 + 탐색 중인 범위)
+
+// 작업서버에 분배한 뒤 아직 끝나지 않은 범위와, 그 범위에서 인정한 share
+typedef struct {
+  unsigned int start;
+  unsigned long long end;
+  unsigned int* shares; // 인정한 share nonce (정렬됨). 같은 share를 두 번 세지 않는 데 쓴다
+  int shareCount;
+  int shareCapacity;
+} OpenRange;
+
+// 작업서버별 열린 범위와 share 집계
+typedef struct {
+  SOCKET socket;
+  unsigned long long shares;  // 검증을 통과한 share 수
+  unsigned long long invalid; // 검증에 실패했거나, 분배하지 않은 범위에 속하거나, 이미 센 share 수
+  bool hasRejected;           // 작업을 거부하여 더 이상 범위를 분배하지 않는지 여부
+  OpenRange ranges[WORKER_OPEN_RANGES]; // 분배한 뒤 아직 끝나지 않은 범위. 분할 모드에서는 share를 보고받는 청크 하나
+  int rangeCount;
+} WorkerStats;
 
 void errProc(const char *);
 void * client_module(void *);
 int makeNbSocket(SOCKET);
+void assignInitialWork(const SOCKET*, int, const dwp_packet*);
+void broadcastStop(const SOCKET*, int);
+bool nextWork(int, const dwp_packet*, dwp_packet*);
+int finishRange(unsigned int, unsigned int);
+void rejectRange(int, unsigned int, unsigned int);
+void mergeResults(const dwp_result*, int);
+int uniqueResults(dwp_result*, int);
+void makeJobKey(const char*, int, unsigned char[32]);
+char* readChallengeFile(const char*);
+SOCKET connectUpstream(const char*);
+void * upstream_module(void *);
+void runRelay(SOCKET, const SOCKET*, int);
+void reportProgress(unsigned int);
+void startShareAccounting(const dwp_packet*, const dwp_job_option*, const SOCKET*, int);
+void acceptShares(int, SOCKET, const dwp_packet*);
+void openRange(WorkerStats*, unsigned int, unsigned long long);
+bool closeRange(WorkerStats*, unsigned int, unsigned long long);
+OpenRange* findShareRange(int, const dwp_packet*);
+bool addShare(OpenRange*, unsigned int);
+double estimateHashRate(const WorkerStats*, double);
+double expectedHashes(int);
+double secondsSince(const struct timespec*);
 
-static int nextNonce = 0;
-static int resultNonce = -1;
+static dispatcher ranges;  // 작업 범위 분배기
+static dwp_packet jobPacket;  // 작업 요청 패킷의 원형. 분배할 때마다 nonce와 작업량만 바꾸어 보낸다
+static dwp_job_option jobOption;  // 모든 범위에 공통으로 붙는 작업 옵션 (챌린지 중간 상태)
+static unsigned int resultNonce = 0;
+static bool hasResult = false;  // 첫 정답 모드에서 정답을 찾았는지 여부. resultNonce는 이 값이 true일 때만 유효하다
+static bool isJobDone = false;  // 작업이 끝났는지 여부 (정답 발견, 탐색 범위 소진)
+static bool isJobRejected = false;  // 모든 작업서버가 작업을 거부하여 탐색하지 못한 범위가 남았는지 여부
+static unsigned int searchMode = DWP_MODE_FIRST;  // 탐색 모드 (DWP_MODE_*)
+static unsigned int resultLimit = 0;  // 상위 k개 모드에서 수집할 정답 수
+static unsigned long long searchEnd = 0x100000000ULL;  // 탐색 종료 nonce
+static dwp_result* results = NULL;  // 모든 정답/상위 k개 모드에서 수집한 정답
+static int resultCount = 0;
+static int resultCapacity = 0;
+static bool isStopped = false;  // 모든 작업서버에 중단 요청을 보냈는지 여부
+static bool isSharded = false;  // 결정적 분할(sharding) 모드 여부
+static unsigned int progressInterval = DEFAULT_PROGRESS_INTERVAL;
+static int exhaustedCount = 0;  // 분할 모드에서 자신의 nonce 구간을 모두 탐색한 작업서버 수
+static unsigned long long hashedCount = 0;  // 분할 모드에서 작업서버들이 보고한 누적 해시 수
+static SOCKET upstreamSd = -1;  // 중계 모드에서 상위 메인서버와 연결된 소켓
+static unsigned int relayWorkload = 0;  // 중계 모드에서 하위 작업서버에 분배할 범위 크기
+static dwp_packet upstreamQueue[DWP_BATCH_MAX]; // 중계 모드에서 상위 메인서버로부터 받은 작업 요청 큐
+static int upstreamHead = 0;
+static int upstreamCount = 0;
+static bool isUpstreamClosed = false; // 상위 메인서버가 중단 요청을 보냈거나 연결이 끊겼는지 여부
+static unsigned int relayCompleted = 0; // 지난 진행 보고 이후 완료된 하위 범위 수
+static unsigned long long relayHashed = 0;  // 지난 진행 보고 이후 탐색한 nonce 수
+static pow_context shareContext; // share 검증에 쓰는 챌린지가 반영된 해시 상태
+static WorkerStats workerStats[NUM_WORKING_SERVER];
+static struct timespec shareStartTime;  // share 집계를 시작한 시각
 static pthread_mutex_t mutex;
-
-typedef struct {
-  dwp_packet packet;
-  SOCKET socket;
-} ThreadParams;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;  // 정답 발견을 메인 스레드에 알리는 조건 변수
 
 int main(int argc, char** argv)
 {
@@ -42,13 +122,99 @@ int main(int argc, char** argv)
   dwp_packet reqPacket;
 	pthread_t thread[NUM_WORKING_SERVER];
 
-	if(argc < 3) {
-    fprintf(stderr, ">> usage: main_server hostname port\n");
+  // 옵션을 처리한다.
+  //  -s : 결정적 분할 모드. 작업서버마다 (작업, 번호, 개수)를 한 번만 전송한다.
+  //  -p interval : 분할 모드의 진행 상황 보고 주기 (청크 수)
+  //  -m mode : 탐색 모드. first(첫 정답), all(모든 정답), topk(해시값이 가장 작은 k개)
+  //  -k limit : topk 모드에서 수집할 정답 수
+  //  -e end : 탐색 종료 nonce. all, topk 모드에서는 필수
+  //  -c path : 정답 캐시 파일 경로. 빈 문자열이면 캐시를 사용하지 않는다
+  //  -r dir : 체크포인트 로그 디렉터리. 빈 문자열이면 체크포인트를 사용하지 않는다
+  //  -u host:port : 중계 모드. 상위 메인서버에 작업서버처럼 연결하여 받은 범위를 하위 작업서버에 나누어 분배한다
+  //  -w workload : 중계 모드에서 하위 작업서버에 분배할 범위 크기
+  //  -f path : 챌린지를 표준 입력 대신 파일 내용 전체로 읽는다
+  //  -a algorithm : 해시 알고리즘. sha256(기본값), sha256d(이중 SHA-256), blake3
+  //  -d difficulty : share 난이도 (DWP_SHARE_DIFFICULTY_MIN 이상). 첫 정답 모드에서 작업서버가 이 난이도를 만족하는 nonce를 share로 보고하며,
+  //                  메인서버는 share를 검증하여 작업서버별 실제 해시 속도와 남은 예상 시간을 추정한다
+  const char* usage = ">> usage: main_server [-s] [-p interval] [-m first|all|topk] [-k limit] [-e end] [-c cache] [-r dir] [-u host:port] [-w workload] [-f challenge] [-a sha256|sha256d|blake3] [-d share_difficulty] hostname port\n";
+  const char* cachePath = DEFAULT_CACHE_PATH;
+  const char* checkpointDir = DEFAULT_CHECKPOINT_DIR;
+  const char* upstream = NULL;
+  const char* challengePath = NULL;
+  int hashAlgorithm = POW_HASH_SHA256;
+  unsigned int shareDifficulty = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "sp:m:k:e:c:r:u:w:f:a:d:")) != -1) {
+    switch (opt) {
+      case 's':
+        isSharded = true;
+        break;
+      case 'p':
+        progressInterval = strtoul(optarg, NULL, 10);
+        break;
+      case 'm':
+        if (strcmp(optarg, "all") == 0) {
+          searchMode = DWP_MODE_ALL;
+        }
+        else if (strcmp(optarg, "topk") == 0) {
+          searchMode = DWP_MODE_TOPK;
+        }
+        else if (strcmp(optarg, "first") != 0) {
+          fprintf(stderr, "%s", usage);
+          return -1;
+        }
+        break;
+      case 'k':
+        resultLimit = strtoul(optarg, NULL, 10);
+        break;
+      case 'e':
+        searchEnd = strtoull(optarg, NULL, 10);
+        break;
+      case 'c':
+        cachePath = optarg;
+        break;
+      case 'r':
+        checkpointDir = optarg;
+        break;
+      case 'u':
+        upstream = optarg;
+        break;
+      case 'w':
+        relayWorkload = strtoul(optarg, NULL, 10);
+        break;
+      case 'f':
+        challengePath = optarg;
+        break;
+      case 'a':
+        hashAlgorithm = pow_find_backend(optarg);
+        if (hashAlgorithm < 0) {
+          fprintf(stderr, "%s", usage);
+          return -1;
+        }
+        break;
+      case 'd':
+        shareDifficulty = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return -1;
+    }
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+
+	if(argc < 3 || searchEnd == 0 || searchEnd > 0x100000000ULL
+      || (searchMode != DWP_MODE_FIRST && searchEnd == 0x100000000ULL)
+      || (searchMode == DWP_MODE_TOPK && (resultLimit == 0 || resultLimit > DWP_RESULT_LIMIT_MAX))) {
+    fprintf(stderr, "%s", usage);
 		return -1;
 	}
 
 	printf(">> Server started\n");
 
+  // 작업서버와 주고받는 패킷마다의 출력은 로그 출력 스레드가 맡아, mutex를 잡은 스레드가 콘솔 출력을 기다리지 않게 한다.
+  log_init();
+
   // 메인서버 주소를 설정한다.
   struct addrinfo hints;
   struct addrinfo *bind_address;
@@ -90,15 +256,28 @@ int main(int argc, char** argv)
 		if(!ISVALIDSOCKET(connectSd[i])) {
 			errProc("accept");
 		}
-    printf(">> A working server is connected\n");
+    LOG_INFO(">> A working server is connected");
 	}
 
+  // 중계 모드에서는 입력을 받지 않고 상위 메인서버가 보내는 범위를 하위 작업서버에 분배한다.
+  if (upstream != NULL) {
+    upstreamSd = connectUpstream(upstream);
+    runRelay(upstreamSd, connectSd, NUM_WORKING_SERVER);
+    CLOSESOCKET(upstreamSd);
+    CLOSESOCKET(listenSd);
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&cond);
+    log_shutdown();
+    return 0;
+  }
+
   // 난이도와 서버당 작업량, 챌린지를 입력받는다.
-  int difficulty, bodylen;
+  int difficulty;
   unsigned int workload;
   char* challenge;
   char input[MAX_INPUT_LENGTH];
   memset(&reqPacket, 0, sizeof(reqPacket));
+  log_flush();
 
   while (true) {
     printf(">> Input difficulty:\n");
@@ -118,61 +297,220 @@ int main(int argc, char** argv)
     }
   }
   
-  while (true) {
+  if (challengePath != NULL) {
+    challenge = readChallengeFile(challengePath);
+    if (challenge == NULL) {
+      fprintf(stderr, "## Failed to read the challenge: %s\n", challengePath);
+      return -1;
+    }
+  }
+  // 챌린지는 길이 제한 없이 한 줄을 입력받는다.
+  while (challengePath == NULL) {
+    size_t capacity = 0;
+    challenge = NULL;
     printf(">> Input challenge:\n");
-    fgets(input, sizeof(input), stdin);
-    input[strcspn(input, "\n")] = '\0'; // 개행문자를 널문자로 변경
-    challenge = strdup(input);
-    bodylen = strlen(challenge);
-    if (bodylen > 0) {
+    if (getline(&challenge, &capacity, stdin) < 0) {
+      free(challenge);
+      return -1;
+    }
+    challenge[strcspn(challenge, "\n")] = '\0'; // 개행문자를 널문자로 변경
+    if (challenge[0] != '\0') {
       break;
     }
     free(challenge);
   }
-  
+  size_t challengeLength = strlen(challenge);
+  if (challengeLength > 0xFFFFFFFFULL) {
+    fprintf(stderr, "## The challenge is too long.\n");
+    return -1;
+  }
+
+  // 챌린지가 64바이트 블록을 넘으면 앞부분 블록들의 SHA-256 중간 상태를 미리 계산하여 작업 옵션으로 보내고,
+  // 요청 바디에는 나머지 꼬리만 담는다. 바디가 비지 않도록 마지막 바이트는 항상 꼬리에 남긴다.
+  // 중간 상태를 지원하지 않는 해시 알고리즘은 챌린지 전체가 요청 바디에 들어가야 한다.
+  memset(&jobOption, 0, sizeof(jobOption));
+  jobOption.hashAlgorithm = hashAlgorithm;
+  // share가 너무 자주 나오면 작업서버의 보고와 메인서버의 검증이 탐색보다 비싸지므로 하한을 둔다.
+  if (shareDifficulty > 0 && shareDifficulty < DWP_SHARE_DIFFICULTY_MIN) {
+    fprintf(stderr, "## The share difficulty is raised to %d.\n", DWP_SHARE_DIFFICULTY_MIN);
+    shareDifficulty = DWP_SHARE_DIFFICULTY_MIN;
+  }
+  if (shareDifficulty > 0 && (searchMode != DWP_MODE_FIRST || (int)shareDifficulty >= difficulty)) {
+    fprintf(stderr, "## Shares are only used in first mode with a share difficulty below %d.\n", difficulty);
+  }
+  else {
+    jobOption.shareDifficulty = shareDifficulty;
+  }
+  if (!pow_get_backend(hashAlgorithm)->hasMidstate && challengeLength > DWP_BODY_LENGTH) {
+    fprintf(stderr, "## The challenge is too long for %s (max %d bytes).\n", pow_get_backend(hashAlgorithm)->name, DWP_BODY_LENGTH);
+    return -1;
+  }
+  if (pow_get_backend(hashAlgorithm)->hasMidstate && challengeLength > SHA256_CBLOCK) {
+    jobOption.prefixLength = pow_midstate(challenge, challengeLength - 1, jobOption.midstate);
+    printf(">> Challenge midstate: %u bytes, tail: %zu bytes\n", jobOption.prefixLength, challengeLength - jobOption.prefixLength);
+  }
+  const char* tail = challenge + jobOption.prefixLength;
+
   // 입력받은 데이터를 토대로 초기 DWP 요청 패킷을 생성한다.
-  dwp_create_req(difficulty, workload, challenge, bodylen, &reqPacket);
+  dwp_create_req(difficulty, workload, tail, strlen(tail), &reqPacket);
+
+  // 정답 캐시를 연다. 열지 못하면 캐시 없이 진행한다.
+  result_cache cache;
+  bool hasCache = cachePath[0] != '\0' && result_cache_open(&cache, cachePath) == 0;
+  if (cachePath[0] != '\0' && !hasCache) {
+    fprintf(stderr, "## Failed to open the cache: %s\n", cachePath);
+  }
 
   // Proof of Work 시작
   clock_t startTime, elapsedtime;
   startTime = clock();
 
-  // 연결된 작업서버에 대한 요청 전송을 멀티스레드로 관리한다.
-  for (int i = 0; i < NUM_WORKING_SERVER; i++) {
-    ThreadParams* params = malloc(sizeof(ThreadParams));
-    params->packet = reqPacket;
-    params->socket = connectSd[i];
-		pthread_create(&thread[i], NULL, client_module, (void *)params);
+  // 같은 챌린지를 같거나 더 높은 난이도로 푼 적이 있다면, 검증 후 작업서버에 분배하지 않고 바로 답한다.
+  bool isCached = false;
+  unsigned int cachedNonce;
+  char hash[65];
+  if (hasCache && searchMode == DWP_MODE_FIRST
+      && result_cache_lookup(&cache, challenge, hashAlgorithm, difficulty, &cachedNonce, hash)
+      && verifyNonce(challenge, cachedNonce, difficulty, hashAlgorithm, hash)) {
+    resultNonce = cachedNonce;
+    hasResult = true;
+    isJobDone = true;
+    isCached = true;
+    printf(">> The answer is found in the cache: %u\n", cachedNonce);
   }
 
-  // 결과 nonce를 찾았는지 계속해서 확인한다.
-  bool isFinished = false;
-  while (true) {
-    pthread_mutex_lock(&mutex); // 뮤텍스를 통해 resultNonce 보호
-    isFinished = resultNonce >= 0;
-    pthread_mutex_unlock(&mutex);
-    
-    if (isFinished) {
-      break;
+  // 범위 분배기를 만들고, 같은 작업의 체크포인트 로그가 있으면 이미 탐색한 범위를 건너뛴다.
+  dispatcher_init(&ranges, workload, 0, searchEnd);
+  if (!isCached && !isSharded && checkpointDir[0] != '\0') {
+    unsigned char key[32];
+    char logPath[MAX_INPUT_LENGTH];
+    makeJobKey(challenge, difficulty, key);
+    snprintf(logPath, sizeof(logPath), "%s/pow_job_%02x%02x%02x%02x%02x%02x%02x%02x.ckpt", checkpointDir,
+      key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7]);
+    if (dispatcher_open_log(&ranges, logPath, key) != 0) {
+      fprintf(stderr, "## Failed to open the checkpoint: %s\n", logPath);
+    }
+    else if (ranges.resumedNonces > 0) {
+      printf(">> Resumed from %s: %llu nonces already searched\n", logPath, ranges.resumedNonces);
+      mergeResults(ranges.hits, ranges.hitCount);
     }
+    // 이전 실행에서 탐색 범위를 모두 마쳤다면 바로 끝낸다.
+    if (dispatcher_is_done(&ranges)) {
+      isJobDone = true;
+    }
+  }
+
+  if (!isCached) {
+    // 모든 작업서버에 초기 작업을 한 번에 분배한다.
+    jobPacket = reqPacket;
+    startShareAccounting(&jobPacket, &jobOption, connectSd, NUM_WORKING_SERVER);
+    assignInitialWork(connectSd, NUM_WORKING_SERVER, &jobPacket);
+
+    // 연결된 작업서버의 응답 처리를 멀티스레드로 관리한다.
+    for (int i = 0; i < NUM_WORKING_SERVER; i++) {
+      ThreadParams* params = malloc(sizeof(ThreadParams));
+      params->socket = connectSd[i];
+      params->index = i;
+      pthread_create(&thread[i], NULL, client_module, (void *)params);
+    }
+  }
+
+  // 결과 nonce를 찾을 때까지 대기한다.
+  pthread_mutex_lock(&mutex); // 뮤텍스를 통해 resultNonce 보호
+  while (!isJobDone) {
+    pthread_cond_wait(&cond, &mutex);
   }
+  pthread_mutex_unlock(&mutex);
+
+  // 모든 작업서버에 중단 요청을 한 번에 전송한다.
+  broadcastStop(connectSd, NUM_WORKING_SERVER);
 
   // Proof of Work 종료
   elapsedtime = clock() - startTime;
+  log_flush();
 
   printf(">> Elapsed Time: %.2lf sec\n", elapsedtime/(double)CLOCKS_PER_SEC);
-  printf(">> Challenge: %s\n", challenge);
+  if (jobOption.prefixLength > 0) {
+    printf(">> Challenge: %zu bytes\n", challengeLength);
+  }
+  else {
+    printf(">> Challenge: %s\n", challenge);
+  }
   printf(">> Difficulty: %d\n", difficulty);
-  printf(">> Nonce: %d\n", resultNonce);
+  printf(">> Hash: %s\n", pow_get_backend(hashAlgorithm)->name);
+  if (searchMode == DWP_MODE_FIRST) {
+    if (hasResult) {
+      printf(">> Nonce: %u\n", resultNonce);
+    }
+    else {
+      printf(">> Nonce: not found\n");
+    }
+  }
+  else {
+    // 작업서버들이 보낸 정답을 해시값 순으로 정렬하여 출력한다.
+    qsort(results, resultCount, sizeof(dwp_result), dwp_compare_result);
+    resultCount = uniqueResults(results, resultCount);
+    printf(">> Results: %d\n", resultCount);
+    for (int i = 0; i < resultCount; i++) {
+      printf(">> %u %.64s\n", results[i].nonce, results[i].hash);
+    }
+  }
+  if (hashedCount > 0) {
+    printf(">> Reported hashes: %llu\n", hashedCount);
+  }
+  if (jobOption.shareDifficulty > 0) {
+    double elapsed = secondsSince(&shareStartTime);
+    unsigned long long shares = 0, invalid = 0;
+    double fleetRate = 0;
+    for (int i = 0; i < NUM_WORKING_SERVER; i++) {
+      shares += workerStats[i].shares;
+      invalid += workerStats[i].invalid;
+      fleetRate += estimateHashRate(&workerStats[i], elapsed);
+    }
+    printf(">> Shares: %llu (%llu invalid), ~%.0f hashes/sec\n", shares, invalid, fleetRate);
+    for (int i = 0; i < NUM_WORKING_SERVER; i++) {
+      printf(">> #%d: %llu shares, ~%.0f hashes/sec\n", workerStats[i].socket, workerStats[i].shares,
+        estimateHashRate(&workerStats[i], elapsed));
+    }
+  }
 
-  for (int i = 0; i < NUM_WORKING_SERVER; i++) {
-    pthread_join(thread[i], NULL);
+  // 검증된 정답을 캐시에 저장한다. 모든 정답/상위 k개 모드에서는 해시값이 가장 작은 정답을 저장한다.
+  if (hasCache && !isCached) {
+    if (searchMode == DWP_MODE_FIRST && hasResult) {
+      if (verifyNonce(challenge, resultNonce, difficulty, hashAlgorithm, hash)) {
+        result_cache_store(&cache, challenge, hashAlgorithm, resultNonce, hash);
+      }
+      else {
+        fprintf(stderr, "## The answer failed verification.\n");
+      }
+    }
+    else if (searchMode != DWP_MODE_FIRST && resultCount > 0
+        && verifyNonce(challenge, results[0].nonce, difficulty, hashAlgorithm, hash)) {
+      result_cache_store(&cache, challenge, hashAlgorithm, results[0].nonce, hash);
+    }
+  }
+  if (hasCache) {
+    result_cache_close(&cache);
+  }
+  if (isJobRejected) {
+    fprintf(stderr, "## Every working server rejected the job. The checkpoint is kept.\n");
+  }
+  // 작업이 끝났으므로 체크포인트 로그를 지운다. 탐색하지 못한 범위가 남았다면 다음 실행을 위해 남겨 둔다.
+  dispatcher_destroy(&ranges, !isJobRejected);
+
+  if (!isCached) {
+    for (int i = 0; i < NUM_WORKING_SERVER; i++) {
+      pthread_join(thread[i], NULL);
+    }
   }
 
 	CLOSESOCKET(listenSd);
   pthread_mutex_destroy(&mutex);
+  pthread_cond_destroy(&cond);
   free(challenge);
+  free(results);
   dwp_destroy(&reqPacket);
+  log_shutdown();
 	return 0;
 }
 
@@ -181,8 +519,10 @@ int main(int argc, char** argv)
 */
 void errProc(const char* str)
 {
-	fprintf(stderr,"## %s: %s\n", str, strerror(errno));
-	exit(errno);
+	int err = errno;
+	log_flush();
+	fprintf(stderr,"## %s: %s\n", str, strerror(err));
+	exit(err);
 }
 
 /**
@@ -192,35 +532,24 @@ void * client_module(void * arg)
 {
   ThreadParams* params = (ThreadParams*)arg;
   SOCKET connectSd = params->socket;
-	dwp_packet reqPacket = params->packet;
+  int index = params->index;
   free(params);
   
   // 작업서버 소켓을 논블로킹 소켓으로 설정한다.
   makeNbSocket(connectSd);
 
-  // 각 멀티스레드에 중복되지 않도록 작업을 분배한다.
-  pthread_mutex_lock(&mutex);
-  reqPacket.nonce = nextNonce;
-  nextNonce += reqPacket.workload;
-  pthread_mutex_unlock(&mutex);
-
-  // 연결된 작업서버에 작업 요청을 전송한다.
-  dwp_send(connectSd, DWP_QR_REQUEST, DWP_TYPE_WORK, &reqPacket);
-	printf(">> The work request is sent to #%d\n", connectSd);
-
-  dwp_packet resPacket;
+  dwp_packet resPacket, workPacket;
 	int recvLen;
-  bool isFinished = false;
+  int action;
+  bool stopped = false;
 
 	while(true) {
-    pthread_mutex_lock(&mutex); // 뮤텍스를 통해 resultNonce 보호
-    isFinished = resultNonce >= 0;
+    pthread_mutex_lock(&mutex); // 뮤텍스를 통해 isStopped 보호
+    stopped = isStopped;
     pthread_mutex_unlock(&mutex);
 
-    // 다른 스레드에서 정답을 구한 경우, 연결된 작업서버에 중단 요청 전송
-    if (isFinished) {
-      dwp_send(connectSd, DWP_QR_REQUEST, DWP_TYPE_STOP, NULL);
-      printf(">> The stop request is sent to #%d\n", connectSd);
+    // 메인 스레드가 모든 작업서버에 중단 요청을 보낸 경우 종료
+    if (stopped) {
       break;
     }
 
@@ -232,42 +561,853 @@ void * client_module(void * arg)
 
     // 패킷이 요청(request) 패킷인 경우 무시한다.
     if (resPacket.data.qr == DWP_QR_REQUEST) {
-      fprintf(stderr, "#%d Invalid request packet.\n", connectSd);
+      LOG_WARN("#%d Invalid request packet.", connectSd);
       continue;
     }
 
     switch (resPacket.data.type) {
       case DWP_TYPE_SUCCESS:  // 수신한 패킷이 성공 응답인 경우
         pthread_mutex_lock(&mutex);
-        isFinished = resultNonce >= 0;
         // 가장 빠르게 제출된 답안을 채택한다.
-        if (!isFinished) {
+        TRACE_PROBE1(hit, resPacket.nonce);
+        if (dispatcher_on_success(&ranges, resPacket.nonce) == DISPATCHER_ACTION_STOP) {
           resultNonce = resPacket.nonce;
-          printf(">> The answer is Found: %d\n", resultNonce);
+          hasResult = true;
+          isJobDone = true;
+          LOG_INFO(">> The answer is Found: %u", resultNonce);
+          pthread_cond_signal(&cond);
         }
         pthread_mutex_unlock(&mutex);
         break;
       case DWP_TYPE_FAIL: // 수신한 패킷이 실패 응답인 경우
         pthread_mutex_lock(&mutex);
-        isFinished = resultNonce >= 0;
-        reqPacket.nonce = nextNonce;
-        nextNonce += reqPacket.workload;
-        // 아직 성공한 작업서버가 없다면, 실패한 작업서버에 다음 작업을 분배
-        if (!isFinished) {
-          dwp_send(connectSd, DWP_QR_REQUEST, DWP_TYPE_WORK, &reqPacket);
-          printf(">> The work request is sent to #%d\n", connectSd);
+        // 분할 모드에서는 작업서버가 자신의 구간을 모두 탐색했다는 의미이다.
+        if (isSharded) {
+          exhaustedCount++;
+          if (exhaustedCount == NUM_WORKING_SERVER) {
+            isJobDone = true;
+            pthread_cond_signal(&cond);
+          }
+          pthread_mutex_unlock(&mutex);
+          break;
+        }
+        // 분배하지 않았거나 이미 끝난 범위의 실패 응답은 완료로 기록하지 않는다.
+        if (!closeRange(&workerStats[index], resPacket.nonce, (unsigned long long)resPacket.nonce + resPacket.workload)) {
+          LOG_WARN("#%d reported an unassigned range [%u..%llu)", connectSd, resPacket.nonce,
+            (unsigned long long)resPacket.nonce + resPacket.workload);
+          pthread_mutex_unlock(&mutex);
+          break;
+        }
+        action = finishRange(resPacket.nonce, resPacket.workload);
+        // 아직 작업이 끝나지 않았다면, 실패한 작업서버에 다음 작업을 분배
+        if (action == DISPATCHER_ACTION_NEXT && !isJobDone && !workerStats[index].hasRejected
+            && nextWork(index, &jobPacket, &workPacket)) {
+          dwp_send(connectSd, DWP_QR_REQUEST, workPacket.data.type, &workPacket);
+          free(workPacket.extBody);
+          LOG_DEBUG(">> The work request is sent to #%d", connectSd);
         }
         pthread_mutex_unlock(&mutex);
         break;
+      case DWP_TYPE_EXT:  // 수신한 패킷이 확장 응답인 경우
+        if (resPacket.ext.kind == DWP_EXT_PROGRESS) {
+          // 분할 모드의 진행 상황 보고: workload는 지난 보고 이후 해시한 nonce 수이다.
+          pthread_mutex_lock(&mutex);
+          hashedCount += resPacket.workload;
+          pthread_mutex_unlock(&mutex);
+          LOG_DEBUG(">> #%d progress: next nonce %u", connectSd, resPacket.nonce);
+        }
+        else if (resPacket.ext.kind == DWP_EXT_RESULTS) {
+          const dwp_result* entries = (const dwp_result*)resPacket.extBody;
+          int count = resPacket.ext.length / sizeof(dwp_result);
+          pthread_mutex_lock(&mutex);
+          // 중계 모드에서는 정답을 그대로 상위 메인서버에 전달한다.
+          if (upstreamSd >= 0) {
+            dwp_send(upstreamSd, DWP_QR_RESPONSE, DWP_TYPE_EXT, &resPacket);
+          }
+          mergeResults(entries, count);
+          if (!isSharded) {
+            for (int i = 0; i < count; i++) {
+              dispatcher_record_hit(&ranges, &entries[i]);
+            }
+          }
+          pthread_mutex_unlock(&mutex);
+        }
+        else if (resPacket.ext.kind == DWP_EXT_SHARES) {
+          acceptShares(index, connectSd, &resPacket);
+        }
+        else if (resPacket.ext.kind == DWP_EXT_REJECT) {
+          // 작업서버가 탐색하지 못하고 돌려준 범위는 다른 작업서버에 다시 분배한다.
+          LOG_WARN("#%d rejected the range [%u..%llu)", connectSd, resPacket.nonce,
+            (unsigned long long)resPacket.nonce + resPacket.workload);
+          pthread_mutex_lock(&mutex);
+          rejectRange(index, resPacket.nonce, resPacket.workload);
+          pthread_mutex_unlock(&mutex);
+        }
+        break;
       default:
-        fprintf(stderr, "#%d Invalid packet type.\n", connectSd);
+        LOG_WARN("#%d Invalid packet type.", connectSd);
         break;
     }
     dwp_destroy(&resPacket);
 	}
 
 	CLOSESOCKET(connectSd);
-	fprintf(stderr,">> The client #%d is disconnected.\n", connectSd);
+	LOG_INFO(">> The client #%d is disconnected.", connectSd);
+}
+
+/**
+  * 모든 작업서버에 초기 작업을 분배하는 함수이다.
+  * 작업서버마다 DISPATCHER_PREFETCH_DEPTH개의 범위를 할당하고, 한 작업서버에 보낼 패킷들은
+  * 한 번의 벡터 쓰기로 묶어 전송한다. 작업서버는 남은 범위를 큐에 보관해 두므로
+  * 실패 응답 후 다음 작업을 기다리는 동안 쉬지 않는다.
+  * 분할 모드에서는 작업서버마다 (작업, 번호, 개수)가 담긴 확장 요청 하나만 전송한다.
+*/
+void assignInitialWork(const SOCKET* sockets, int count, const dwp_packet* reqPacket)
+{
+  dwp_packet batch[DISPATCHER_PREFETCH_DEPTH];
+
+  if (isSharded) {
+    for (int i = 0; i < count; i++) {
+      dwp_job_option option = jobOption;
+      option.shardIndex = i;
+      option.shardCount = count;
+      option.progressInterval = progressInterval;
+      option.searchMode = searchMode;
+      option.resultLimit = resultLimit;
+      option.searchEnd = searchEnd < 0x100000000ULL ? (unsigned int)searchEnd : 0;
+      batch[0] = *reqPacket;
+      dwp_set_ext(&batch[0], DWP_EXT_JOB, 0, &option, sizeof(option));
+      dwp_send_batch(sockets[i], batch, 1);
+      free(batch[0].extBody);
+      LOG_DEBUG(">> The shard %d/%d is sent to #%d", i, count, sockets[i]);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  for (int i = 0; i < count; i++) {
+    int size = 0;
+    while (size < DISPATCHER_PREFETCH_DEPTH && nextWork(i, reqPacket, &batch[size])) {
+      size++;
+    }
+    if (size == 0) {
+      break;
+    }
+    dwp_send_batch(sockets[i], batch, size);
+    for (int j = 0; j < size; j++) {
+      free(batch[j].extBody);
+    }
+    LOG_DEBUG(">> %d work requests are sent to #%d", size, sockets[i]);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+/**
+  * 다음 작업 범위를 할당하여 index번 작업서버에 보낼 작업 요청 패킷을 만드는 함수이다. mutex를 잡은 상태에서 호출한다.
+  * 할당한 범위는 작업서버의 열린 범위로 기록하여, 실패/거부 응답과 share가 분배한 범위에 대한 것인지 확인한다.
+  * 작업서버의 열린 범위가 가득 차 있으면 할당하지 않는다.
+  * 첫 정답 모드가 아니거나 챌린지 중간 상태가 있거나 SHA-256이 아닌 해시 알고리즘이거나 share를 보고받으면 작업 옵션이 담긴 확장 요청을 만들며,
+  * 이때 할당된 확장 바디는 호출한 쪽에서 해제한다.
+  * 탐색 종료 nonce에 도달하여 더 할당할 범위가 없으면 false를 반환한다.
+*/
+bool nextWork(int index, const dwp_packet* reqPacket, dwp_packet* packet)
+{
+  unsigned int start, length;
+  if (workerStats[index].rangeCount == WORKER_OPEN_RANGES) {
+    LOG_WARN("## Too many open ranges for #%d", workerStats[index].socket);
+    return false;
+  }
+  if (!dispatcher_next(&ranges, &start, &length)) {
+    return false;
+  }
+  openRange(&workerStats[index], start, (unsigned long long)start + length);
+
+  TRACE_PROBE2(range_start, start, length);
+  *packet = *reqPacket;
+  packet->data.type = DWP_TYPE_WORK;
+  packet->nonce = start;
+  packet->workload = length;
+  packet->extBody = NULL;
+
+  if (searchMode != DWP_MODE_FIRST || jobOption.prefixLength > 0 || jobOption.hashAlgorithm != POW_HASH_SHA256
+      || jobOption.shareDifficulty > 0) {
+    dwp_job_option option = jobOption;
+    option.searchMode = searchMode;
+    option.resultLimit = resultLimit;
+    dwp_set_ext(packet, DWP_EXT_JOB, 0, &option, sizeof(option));
+  }
+  return true;
+}
+
+/**
+  * 작업 범위 하나가 완료되었음을 기록하고, 분배기의 정책에 따라 다음에 할 일(DISPATCHER_ACTION_*)을 반환하는 함수이다.
+  * mutex를 잡은 상태에서 호출한다. 완료된 범위는 체크포인트 로그에 남으며, 모든 범위를 분배했고 분배한 범위가
+  * 모두 완료되었다면 작업을 끝낸다.
+*/
+int finishRange(unsigned int start, unsigned int length)
+{
+  TRACE_PROBE3(range_end, start, length, 0);
+  // 중계 모드에서는 완료된 하위 범위를 모아 주기적으로 상위 메인서버에 보고한다.
+  if (upstreamSd >= 0) {
+    relayHashed += length;
+    if (progressInterval > 0 && ++relayCompleted >= progressInterval) {
+      reportProgress(ranges.nextNonce);
+    }
+  }
+  int action = dispatcher_on_fail(&ranges, start, length);
+  if (action == DISPATCHER_ACTION_STOP) {
+    isJobDone = true;
+    pthread_cond_signal(&cond);
+  }
+  return action;
+}
+
+/**
+  * 작업서버가 거부한 범위를 되돌려 다른 작업서버에 분배하는 함수이다. mutex를 잡은 상태에서 호출한다.
+  * 거부한 작업서버에는 이후 범위를 분배하지 않는다. 거부하지 않은 작업서버가 남아 있지 않으면
+  * 탐색하지 못한 범위가 남은 채로 작업을 끝낸다. 작업서버에 분배하지 않았거나 이미 끝난 범위의 거부는 무시한다.
+  * 분할 모드에서는 다른 작업서버가 대신 탐색할 수 없으므로, 해당 구간을 탐색하지 못한 것으로 보고 작업서버를 소진된 것으로 센다.
+*/
+void rejectRange(int index, unsigned int start, unsigned int length)
+{
+  static int nextIndex = 0;  // 되돌린 범위를 받을 작업서버를 돌아가며 고른다
+  dwp_packet workPacket;
+
+  if (isSharded) {
+    workerStats[index].hasRejected = true;
+    if (workerStats[index].rangeCount > 0) {
+      closeRange(&workerStats[index], workerStats[index].ranges[0].start, workerStats[index].ranges[0].end);
+    }
+    LOG_ERROR("## The shard of #%d is not searched.", workerStats[index].socket);
+    isJobRejected = true;
+    exhaustedCount++;
+    if (exhaustedCount == NUM_WORKING_SERVER) {
+      isJobDone = true;
+      pthread_cond_signal(&cond);
+    }
+    return;
+  }
+
+  // 분배하지 않았거나 이미 끝난 범위는 되돌리지 않는다.
+  if (!closeRange(&workerStats[index], start, (unsigned long long)start + length)) {
+    LOG_WARN("#%d rejected an unassigned range [%u..%llu)", workerStats[index].socket, start,
+      (unsigned long long)start + length);
+    return;
+  }
+  workerStats[index].hasRejected = true;
+  if (dispatcher_release(&ranges, start, length) != 0) {
+    LOG_ERROR("## Failed to release the range [%u..%llu)", start, (unsigned long long)start + length);
+    isJobRejected = true;
+    isJobDone = true;
+    pthread_cond_signal(&cond);
+    return;
+  }
+  if (isJobDone) {
+    return;
+  }
+
+  for (int i = 0; i < NUM_WORKING_SERVER; i++) {
+    int target = (nextIndex + i) % NUM_WORKING_SERVER;
+    WorkerStats* stats = &workerStats[target];
+    if (stats->hasRejected) {
+      continue;
+    }
+    nextIndex = (target + 1) % NUM_WORKING_SERVER;
+    if (nextWork(target, &jobPacket, &workPacket)) {
+      dwp_send(stats->socket, DWP_QR_REQUEST, workPacket.data.type, &workPacket);
+      free(workPacket.extBody);
+      LOG_DEBUG(">> The released range is sent to #%d", stats->socket);
+    }
+    return;
+  }
+
+  LOG_ERROR("## Every working server rejected the job.");
+  isJobRejected = true;
+  isJobDone = true;
+  pthread_cond_signal(&cond);
+}
+
+/**
+  * 정답들을 수집한 정답에 합치는 함수이다. mutex를 잡은 상태에서 호출한다.
+  * 상위 k개 모드에서는 수집한 정답이 k개를 넘으면 해시값이 작은 k개만 남긴다.
+*/
+void mergeResults(const dwp_result* entries, int count)
+{
+  if (count <= 0) {
+    return;
+  }
+  if (resultCount + count > resultCapacity) {
+    int capacity = resultCapacity > 0 ? resultCapacity : DWP_RESULT_BATCH;
+    while (capacity < resultCount + count) {
+      capacity *= 2;
+    }
+    dwp_result* grown = (dwp_result*)realloc(results, capacity * sizeof(dwp_result));
+    if (grown == NULL) {
+      fprintf(stderr, "## Failed to merge results.\n");
+      return;
+    }
+    results = grown;
+    resultCapacity = capacity;
+  }
+  memcpy(&results[resultCount], entries, count * sizeof(dwp_result));
+  resultCount += count;
+
+  if (searchMode == DWP_MODE_TOPK && resultCount > (int)resultLimit) {
+    qsort(results, resultCount, sizeof(dwp_result), dwp_compare_result);
+    resultCount = uniqueResults(results, resultCount);
+    if (resultCount > (int)resultLimit) {
+      resultCount = resultLimit;
+    }
+  }
+}
+
+/**
+  * 정렬된 정답 배열에서 중복된 정답을 제거하는 함수이다.
+  * 체크포인트에서 이어서 탐색하면 완료 기록 전에 보고된 범위의 정답이 다시 보고될 수 있다.
+*/
+int uniqueResults(dwp_result* entries, int count)
+{
+  int size = 0;
+  for (int i = 0; i < count; i++) {
+    if (size == 0 || dwp_compare_result(&entries[size - 1], &entries[i]) != 0) {
+      entries[size++] = entries[i];
+    }
+  }
+  return size;
+}
+
+/**
+  * 체크포인트 로그를 구분하기 위한 작업 식별자를 만드는 함수이다.
+  * 완료된 범위는 챌린지, 난이도, 탐색 모드, 해시 알고리즘이 같을 때만 재사용할 수 있다.
+*/
+void makeJobKey(const char* challenge, int difficulty, unsigned char key[32])
+{
+  size_t size = strlen(challenge) + 64;
+  char* job = (char*)malloc(size);
+  if (job == NULL) {
+    memset(key, 0, 32);
+    return;
+  }
+  snprintf(job, size, "%d:%u:%u:%u:%s", difficulty, searchMode, resultLimit, jobOption.hashAlgorithm, challenge);
+  SHA256((const unsigned char*)job, strlen(job), key);
+  free(job);
+}
+
+/**
+  * 파일 내용 전체를 챌린지로 읽는 함수이다. 비어 있거나 널 문자가 포함된 파일이면 NULL을 반환한다.
+*/
+char* readChallengeFile(const char* path)
+{
+  FILE* fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return NULL;
+  }
+  char* challenge = NULL;
+  size_t length = 0;
+  if (fseek(fp, 0, SEEK_END) == 0) {
+    long size = ftell(fp);
+    challenge = size > 0 ? (char*)malloc(size + 1) : NULL;
+    if (challenge != NULL) {
+      rewind(fp);
+      length = fread(challenge, 1, size, fp);
+      challenge[length] = '\0';
+    }
+  }
+  fclose(fp);
+
+  if (challenge != NULL && (length == 0 || strlen(challenge) != length)) {
+    free(challenge);
+    challenge = NULL;
+  }
+  return challenge;
+}
+
+/**
+  * "host:port" 형식의 주소로 상위 메인서버에 연결하는 함수이다.
+*/
+SOCKET connectUpstream(const char* address)
+{
+  char host[MAX_INPUT_LENGTH];
+  const char* port = strrchr(address, ':');
+  if (port == NULL || port - address >= (long)sizeof(host)) {
+    fprintf(stderr, "## Invalid upstream address: %s\n", address);
+    exit(-1);
+  }
+  memcpy(host, address, port - address);
+  host[port - address] = '\0';
+  port++;
+
+  struct addrinfo hints;
+  struct addrinfo *peer_address;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, port, &hints, &peer_address)) {
+    errProc("getaddrinfo");
+  }
+
+  SOCKET sd = socket(peer_address->ai_family, peer_address->ai_socktype, peer_address->ai_protocol);
+  if (!ISVALIDSOCKET(sd)) {
+    errProc("socket");
+  }
+  if (connect(sd, peer_address->ai_addr, peer_address->ai_addrlen)) {
+    errProc("connect");
+  }
+  freeaddrinfo(peer_address);
+
+  LOG_INFO(">> Connected to upstream main server");
+  return sd;
+}
+
+/**
+  * 중계 모드에서 상위 메인서버가 보낸 패킷을 수신하는 멀티스레드 함수이다.
+  * 작업 요청은 큐에 넣고, 중단 요청을 받거나 연결이 끊기면 메인 스레드에 알린다.
+*/
+void * upstream_module(void * arg)
+{
+  SOCKET sd = *(SOCKET*)arg;
+  dwp_packet reqPacket;
+
+  while (true) {
+    if (dwp_recv(sd, &reqPacket) < 0) {
+      break;
+    }
+    if (reqPacket.data.qr == DWP_QR_RESPONSE) {
+      LOG_WARN("## Invalid response packet from upstream.");
+      dwp_destroy(&reqPacket);
+      continue;
+    }
+    if (reqPacket.data.type == DWP_TYPE_STOP) {
+      LOG_INFO(">> The stop request is received from upstream");
+      break;
+    }
+
+    pthread_mutex_lock(&mutex);
+    if (upstreamCount < DWP_BATCH_MAX) {
+      upstreamQueue[(upstreamHead + upstreamCount) % DWP_BATCH_MAX] = reqPacket;
+      upstreamCount++;
+      pthread_cond_signal(&cond);
+    }
+    else {
+      LOG_WARN("## Upstream work queue is full.");
+      dwp_destroy(&reqPacket);
+    }
+    pthread_mutex_unlock(&mutex);
+  }
+
+  pthread_mutex_lock(&mutex);
+  isUpstreamClosed = true;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&mutex);
+  return NULL;
+}
+
+/**
+  * 중계 모드의 메인 루프이다.
+  * 상위 메인서버로부터 받은 큰 범위 하나를 relayWorkload 크기로 나누어 하위 작업서버에 분배하고,
+  * 하위 범위가 모두 끝나면 상위 메인서버에 범위 완료(실패 응답)를, 정답을 찾으면 성공 응답을 보낸다.
+  * 상위 메인서버는 이 메인서버를 작업서버 하나로 보므로, 메인서버를 트리 형태로 연결할 수 있다.
+*/
+void runRelay(SOCKET sd, const SOCKET* sockets, int count)
+{
+  pthread_t upstreamThread;
+  pthread_t thread[NUM_WORKING_SERVER];
+  bool isSolved = false;
+
+  memset(&jobPacket, 0, sizeof(jobPacket));
+  pthread_create(&upstreamThread, NULL, upstream_module, (void *)&sd);
+  for (int i = 0; i < count; i++) {
+    ThreadParams* params = malloc(sizeof(ThreadParams));
+    params->socket = sockets[i];
+    params->index = i;
+    pthread_create(&thread[i], NULL, client_module, (void *)params);
+  }
+
+  pthread_mutex_lock(&mutex);
+  while (true) {
+    // 상위 메인서버의 작업 요청을 기다린다. 정답을 보낸 뒤에는 중단 요청만 기다린다.
+    while (!isUpstreamClosed && (isSolved || upstreamCount == 0)) {
+      pthread_cond_wait(&cond, &mutex);
+    }
+    if (isUpstreamClosed) {
+      break;
+    }
+
+    // 받은 범위와 작업 옵션으로 새 작업을 시작한다.
+    dwp_destroy(&jobPacket);
+    jobPacket = upstreamQueue[upstreamHead];
+    upstreamHead = (upstreamHead + 1) % DWP_BATCH_MAX;
+    upstreamCount--;
+
+    dwp_job_option option;
+    memset(&option, 0, sizeof(option));
+    dwp_get_ext(&jobPacket, &option, sizeof(option));
+    if (option.shardCount > 0) {
+      LOG_WARN("## Sharded jobs cannot be relayed.");
+      dwp_send(sd, DWP_QR_RESPONSE, DWP_TYPE_FAIL, NULL);
+      continue;
+    }
+    jobOption = option;
+    searchMode = option.searchMode;
+    resultLimit = option.resultLimit;
+    unsigned int subWorkload = relayWorkload > 0 ? relayWorkload : jobPacket.workload / (count * 8);
+    if (subWorkload == 0) {
+      subWorkload = 1;
+    }
+    dispatcher_init(&ranges, subWorkload, jobPacket.nonce, (unsigned long long)jobPacket.nonce + jobPacket.workload);
+    hasResult = false;
+    isJobDone = false;
+    isJobRejected = false;
+    LOG_INFO(">> Relay range [%u..%llu) in ranges of %u", jobPacket.nonce,
+      (unsigned long long)jobPacket.nonce + jobPacket.workload, subWorkload);
+    pthread_mutex_unlock(&mutex);
+
+    startShareAccounting(&jobPacket, &jobOption, sockets, count);
+    assignInitialWork(sockets, count, &jobPacket);
+
+    pthread_mutex_lock(&mutex);
+    while (!isJobDone && !isUpstreamClosed) {
+      pthread_cond_wait(&cond, &mutex);
+    }
+    if (!isJobDone) {
+      break;
+    }
+
+    if (hasResult) {
+      // 하위 작업서버가 찾은 정답을 상위 메인서버에 전달한다.
+      dwp_packet resPacket;
+      dwp_create_res(jobPacket.data.difficulty, resultNonce, jobPacket.workload, jobPacket.challenge,
+        jobPacket.data.bodylen, &resPacket);
+      dwp_send(sd, DWP_QR_RESPONSE, DWP_TYPE_SUCCESS, &resPacket);
+      dwp_destroy(&resPacket);
+      isSolved = true;
+      // 정답을 보낸 뒤에는 더 이상 작업을 받지 않으므로, 상위 메인서버의 중단 요청을 기다리지 않고 하위 작업서버를 멈춘다.
+      pthread_mutex_unlock(&mutex);
+      broadcastStop(sockets, count);
+      pthread_mutex_lock(&mutex);
+    }
+    else if (isJobRejected) {
+      // 하위 작업서버가 모두 거부했다면 받은 범위를 그대로 상위 메인서버에 돌려준다.
+      dwp_packet rejectPacket;
+      dwp_create_ext(DWP_QR_RESPONSE, DWP_EXT_REJECT, jobPacket.nonce, jobPacket.workload, NULL, 0, &rejectPacket);
+      dwp_send(sd, DWP_QR_RESPONSE, DWP_TYPE_EXT, &rejectPacket);
+      dwp_destroy(&rejectPacket);
+    }
+    else {
+      // 남은 진행 상황과 범위 완료를 보고한다.
+      reportProgress(jobPacket.nonce + jobPacket.workload);
+      dwp_packet failPacket;
+      dwp_create_stop(DWP_QR_RESPONSE, &failPacket);
+      failPacket.nonce = jobPacket.nonce;
+      failPacket.workload = jobPacket.workload;
+      dwp_send(sd, DWP_QR_RESPONSE, DWP_TYPE_FAIL, &failPacket);
+    }
+    dispatcher_destroy(&ranges, false);
+  }
+  pthread_mutex_unlock(&mutex);
+
+  // 상위 메인서버의 중단 요청을 하위 작업서버에 전달한다. 정답을 보냈다면 이미 멈추었다.
+  if (!isSolved) {
+    broadcastStop(sockets, count);
+  }
+  for (int i = 0; i < count; i++) {
+    pthread_join(thread[i], NULL);
+  }
+  shutdown(sd, SHUT_RDWR);
+  pthread_join(upstreamThread, NULL);
+
+  while (upstreamCount > 0) {
+    dwp_destroy(&upstreamQueue[upstreamHead]);
+    upstreamHead = (upstreamHead + 1) % DWP_BATCH_MAX;
+    upstreamCount--;
+  }
+  dwp_destroy(&jobPacket);
+  free(results);
+}
+
+/**
+  * 중계 모드에서 지난 보고 이후 탐색한 nonce 수를 상위 메인서버에 보고하는 함수이다. mutex를 잡은 상태에서 호출한다.
+*/
+void reportProgress(unsigned int nextNonce)
+{
+  if (relayHashed == 0) {
+    return;
+  }
+  dwp_packet progressPacket;
+  dwp_create_ext(DWP_QR_RESPONSE, DWP_EXT_PROGRESS, nextNonce, relayHashed, NULL, 0, &progressPacket);
+  dwp_send(upstreamSd, DWP_QR_RESPONSE, DWP_TYPE_EXT, &progressPacket);
+  dwp_destroy(&progressPacket);
+  relayCompleted = 0;
+  relayHashed = 0;
+}
+
+/**
+  * 새 작업의 share 집계를 시작하는 함수이다. 작업 옵션에 share 난이도가 있으면 share 검증에 쓸 해시 상태를 만들고
+  * 작업서버별 집계, 거부 여부, 열린 범위를 초기화한다. 작업서버에 작업을 분배하기 전에 호출한다.
+*/
+void startShareAccounting(const dwp_packet* reqPacket, const dwp_job_option* option, const SOCKET* sockets, int count)
+{
+  pthread_mutex_lock(&mutex);
+  if (option->prefixLength > 0) {
+    pow_context_resume(&shareContext, option->hashAlgorithm, option->midstate, option->prefixLength,
+      reqPacket->challenge, reqPacket->data.bodylen);
+  }
+  else {
+    pow_context_init(&shareContext, option->hashAlgorithm, reqPacket->challenge, reqPacket->data.bodylen);
+  }
+  for (int i = 0; i < count; i++) {
+    workerStats[i].socket = sockets[i];
+    workerStats[i].shares = 0;
+    workerStats[i].invalid = 0;
+    workerStats[i].hasRejected = false;
+    while (workerStats[i].rangeCount > 0) {
+      closeRange(&workerStats[i], workerStats[i].ranges[0].start, workerStats[i].ranges[0].end);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &shareStartTime);
+  pthread_mutex_unlock(&mutex);
+}
+
+/**
+  * 작업서버가 보낸 share 보고를 검증하여 집계하는 함수이다.
+  * share마다 해시를 한 번 계산하여 share 난이도를 만족하는지 확인하며, 계산은 mutex 밖에서 한다.
+  * 보고에 적힌 범위가 작업서버에 분배한 범위 안에 있어야 하고, share는 보고에 적힌 범위 안에 있어야 하며,
+  * 같은 범위에서 이미 센 share는 다시 세지 않는다. 어느 하나라도 어긋난 share는 실패로 센다.
+  * 중계 모드에서는 모두 인정된 보고를 상위 메인서버에 그대로 전달하여, 상위 메인서버가 이 메인서버의 해시 속도를 추정하게 한다.
+*/
+void acceptShares(int index, SOCKET connectSd, const dwp_packet* packet)
+{
+  const unsigned int* nonces = (const unsigned int*)packet->extBody;
+  int count = packet->ext.length / sizeof(unsigned int);
+  unsigned long long end = (unsigned long long)packet->nonce + packet->workload;
+  bool passed[count > 0 ? count : 1];
+  int valid = 0;
+  char hash[65];
+  pow_context context;
+
+  pthread_mutex_lock(&mutex);
+  context = shareContext;
+  int shareDifficulty = jobOption.shareDifficulty;
+  pthread_mutex_unlock(&mutex);
+  if (shareDifficulty == 0 || count == 0) {
+    return;
+  }
+
+  for (int i = 0; i < count; i++) {
+    passed[i] = nonces[i] >= packet->nonce && nonces[i] < end;
+    if (passed[i]) {
+      pow_hash_nonce(&context, nonces[i], hash);
+      passed[i] = hashDifficulty(hash) >= shareDifficulty;
+    }
+  }
+
+  pthread_mutex_lock(&mutex);
+  WorkerStats* stats = &workerStats[index];
+  OpenRange* range = findShareRange(index, packet);
+  if (range == NULL) {
+    LOG_WARN("#%d reported shares from an unassigned range [%u..%llu)", connectSd, packet->nonce, end);
+  }
+  else {
+    for (int i = 0; i < count; i++) {
+      if (passed[i] && addShare(range, nonces[i])) {
+        valid++;
+      }
+    }
+  }
+  stats->shares += valid;
+  stats->invalid += count - valid;
+  if (upstreamSd >= 0 && valid == count) {
+    dwp_send(upstreamSd, DWP_QR_RESPONSE, DWP_TYPE_EXT, packet);
+  }
+  double elapsed = secondsSince(&shareStartTime);
+  double rate = estimateHashRate(stats, elapsed);
+  double fleetRate = 0;
+  for (int i = 0; i < NUM_WORKING_SERVER; i++) {
+    fleetRate += estimateHashRate(&workerStats[i], elapsed);
+  }
+  int difficulty = jobPacket.data.difficulty;
+  pthread_mutex_unlock(&mutex);
+
+  if (valid < count) {
+    LOG_WARN("#%d %d of %d shares were rejected.", connectSd, count - valid, count);
+  }
+  // 첫 정답까지 필요한 해시 수는 기하분포를 따르므로, 남은 예상 시간은 지금까지 탐색한 양과 무관하다.
+  LOG_DEBUG(">> #%d shares: %d, ~%.0f hashes/sec, fleet ~%.0f hashes/sec, expected %.1f sec to solve", connectSd,
+    valid, rate, fleetRate, fleetRate > 0 ? expectedHashes(difficulty) / fleetRate : 0.0);
+}
+
+/**
+  * 작업서버에 분배한 범위를 열린 범위로 기록하는 함수이다. mutex를 잡은 상태에서 호출한다.
+  * 작업서버가 받아 둘 수 있는 범위보다 많이 열리면 기록하지 않으며, 그 범위의 share는 인정되지 않는다.
+*/
+void openRange(WorkerStats* stats, unsigned int start, unsigned long long end)
+{
+  if (stats->rangeCount == WORKER_OPEN_RANGES) {
+    LOG_WARN("## Too many open ranges for #%d", stats->socket);
+    return;
+  }
+  OpenRange* range = &stats->ranges[stats->rangeCount++];
+  range->start = start;
+  range->end = end;
+  range->shares = NULL;
+  range->shareCount = 0;
+  range->shareCapacity = 0;
+}
+
+/**
+  * 끝났거나 거부된 범위를 닫고, 그 범위에서 인정한 share 목록을 버리는 함수이다. mutex를 잡은 상태에서 호출한다.
+  * @return 시작과 끝이 모두 같은 열린 범위가 없으면 false
+*/
+bool closeRange(WorkerStats* stats, unsigned int start, unsigned long long end)
+{
+  for (int i = 0; i < stats->rangeCount; i++) {
+    if (stats->ranges[i].start == start && stats->ranges[i].end == end) {
+      free(stats->ranges[i].shares);
+      stats->ranges[i] = stats->ranges[--stats->rangeCount];
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+  * share 보고에 적힌 범위를 포함하는 작업서버의 열린 범위를 찾는 함수이다. mutex를 잡은 상태에서 호출한다.
+  * 중계 메인서버는 분배받은 범위를 나눈 하위 범위로 보고하므로, 정확히 같은 범위가 아니라 포함하는 범위를 찾는다.
+  * 분할 모드에서 index번 작업서버는 작업 시작 nonce부터 작업량 크기의 청크를 작업서버 수마다 하나씩 차례로 탐색하므로,
+  * 자신의 청크인지 확인하고, 지나간 청크의 보고는 받지 않으며, 새 청크에서 중복 확인을 새로 시작한다.
+  * @return 없으면 NULL
+*/
+OpenRange* findShareRange(int index, const dwp_packet* packet)
+{
+  WorkerStats* stats = &workerStats[index];
+  unsigned long long end = (unsigned long long)packet->nonce + packet->workload;
+
+  if (isSharded) {
+    unsigned int chunk = jobPacket.workload;
+    if (chunk == 0 || packet->nonce < jobPacket.nonce || packet->workload > chunk) {
+      return NULL;
+    }
+    unsigned long long offset = packet->nonce - jobPacket.nonce;
+    if (offset % chunk != 0 || offset / chunk % NUM_WORKING_SERVER != (unsigned long long)index) {
+      return NULL;
+    }
+    if (stats->rangeCount > 0 && packet->nonce < stats->ranges[0].start) {
+      return NULL;
+    }
+    if (stats->rangeCount == 0 || packet->nonce > stats->ranges[0].start) {
+      if (stats->rangeCount > 0) {
+        closeRange(stats, stats->ranges[0].start, stats->ranges[0].end);
+      }
+      openRange(stats, packet->nonce, packet->nonce + (unsigned long long)chunk);
+    }
+    return &stats->ranges[0];
+  }
+
+  for (int i = 0; i < stats->rangeCount; i++) {
+    if (packet->nonce >= stats->ranges[i].start && end <= stats->ranges[i].end) {
+      return &stats->ranges[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+  * 열린 범위에서 처음 보는 share를 정렬된 목록에 넣는 함수이다. mutex를 잡은 상태에서 호출한다.
+  * @return 이미 센 share이거나 목록을 늘리지 못하면 false
+*/
+bool addShare(OpenRange* range, unsigned int nonce)
+{
+  int low = 0, high = range->shareCount;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (range->shares[mid] < nonce) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
+    }
+  }
+  if (low < range->shareCount && range->shares[low] == nonce) {
+    return false;
+  }
+
+  if (range->shareCount == range->shareCapacity) {
+    int capacity = range->shareCapacity > 0 ? range->shareCapacity * 2 : DWP_SHARE_BATCH;
+    unsigned int* grown = (unsigned int*)realloc(range->shares, capacity * sizeof(unsigned int));
+    if (grown == NULL) {
+      return false;
+    }
+    range->shares = grown;
+    range->shareCapacity = capacity;
+  }
+  memmove(range->shares + low + 1, range->shares + low, (range->shareCount - low) * sizeof(unsigned int));
+  range->shares[low] = nonce;
+  range->shareCount++;
+  return true;
+}
+
+/**
+  * 검증된 share 수로 작업서버의 해시 속도를 추정하는 함수이다.
+  * share 하나는 평균 16^share 난이도 번의 해시마다 하나씩 나오므로, share 수에 이를 곱하면 실제 탐색한 해시 수가 된다.
+*/
+double estimateHashRate(const WorkerStats* stats, double elapsed)
+{
+  if (elapsed <= 0) {
+    return 0;
+  }
+  return stats->shares * expectedHashes(jobOption.shareDifficulty) / elapsed;
+}
+
+/**
+  * 난이도를 만족하는 nonce 하나를 찾는 데 필요한 평균 해시 수(16^난이도)를 반환하는 함수이다.
+*/
+double expectedHashes(int difficulty)
+{
+  double hashes = 1;
+  for (int i = 0; i < difficulty; i++) {
+    hashes *= 16;
+  }
+  return hashes;
+}
+
+/**
+  * 주어진 시각 이후 흐른 시간(초)을 반환하는 함수이다.
+*/
+double secondsSince(const struct timespec* start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+  * 모든 작업서버에 중단 요청을 한 번에 전송하는 함수이다.
+  * 각 스레드가 정답 발견을 알아차리기를 기다리지 않고 메인 스레드에서 곧바로 전송하므로,
+  * 정답 발견 이후 작업서버들이 낭비하는 해시 연산이 줄어든다.
+  * 작업이 끝났음을 mutex 안에서 먼저 표시하여 다른 스레드가 더 이상 작업 요청을 보내지 않게 한 뒤,
+  * 중단 요청은 mutex 밖에서 보내므로 송신이 막혀도 다른 작업서버의 응답 처리를 붙잡지 않는다.
+  * 각 스레드는 isStopped를 보고 소켓을 닫으므로, isStopped는 모든 송신을 마친 뒤에 설정한다.
+*/
+void broadcastStop(const SOCKET* sockets, int count)
+{
+  dwp_packet stopPacket;
+  dwp_create_stop(DWP_QR_REQUEST, &stopPacket);
+
+  pthread_mutex_lock(&mutex);
+  isJobDone = true;
+  pthread_mutex_unlock(&mutex);
+
+  for (int i = 0; i < count; i++) {
+    TRACE_PROBE1(stop, sockets[i]);
+    dwp_send_batch(sockets[i], &stopPacket, 1);
+  }
+
+  pthread_mutex_lock(&mutex);
+  isStopped = true;
+  pthread_mutex_unlock(&mutex);
+
+  for (int i = 0; i < count; i++) {
+    LOG_INFO(">> The stop request is sent to #%d", sockets[i]);
+  }
 }
 
 /**
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf_trace.h"
+
+// perf_counters.fd 순서의 하드웨어 이벤트
+static const unsigned long long EVENTS[PERF_COUNTER_COUNT] = {
+  PERF_COUNT_HW_CPU_CYCLES,
+  PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int perf_counters_open(perf_counters* counters)
+{
+  struct perf_event_attr attr;
+  int opened = 0;
+
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = EVENTS[i];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // pid 0, cpu -1: 호출한 스레드가 어느 CPU에서 실행되든 센다.
+    counters->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (counters->fd[i] >= 0) {
+      opened++;
+    }
+  }
+  return opened > 0 ? 0 : -1;
+}
+
+void perf_counters_start(perf_counters* counters)
+{
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    if (counters->fd[i] >= 0) {
+      ioctl(counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void perf_counters_stop(perf_counters* counters, perf_sample* sample)
+{
+  unsigned long long* values[PERF_COUNTER_COUNT] = { &sample->cycles, &sample->instructions, &sample->branchMisses };
+  unsigned long long value;
+
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    if (counters->fd[i] < 0) {
+      continue;
+    }
+    ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(counters->fd[i], &value, sizeof(value)) == sizeof(value)) {
+      *values[i] += value;
+    }
+  }
+}
+
+void perf_counters_close(perf_counters* counters)
+{
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    if (counters->fd[i] >= 0) {
+      close(counters->fd[i]);
+      counters->fd[i] = -1;
+    }
+  }
+}
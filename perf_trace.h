@@ -0,0 +1,63 @@
+#ifndef PERF_TRACE_H
+#define PERF_TRACE_H
+
+#include <stdbool.h>
+
+// USDT(정적 사용자 공간 트레이스포인트) 프로브.
+// <sys/sdt.h>(systemtap-sdt-dev)가 있으면 프로브마다 nop 명령 하나와 ELF 노트를 심으며,
+// bpftrace, perf probe 등으로 붙기 전에는 아무 동작도 하지 않는다. 없으면 빈 매크로로 컴파일된다.
+// -DPOW_NO_USDT로 빌드하면 sys/sdt.h가 있어도 프로브를 넣지 않는다.
+//
+// 프로브 목록 (공급자 pow):
+//  packet_send(fd, qr, type)        DWP 패킷 송신 (dwp_send, dwp_send_batch의 패킷마다)
+//  packet_recv(fd, qr, type)        DWP 패킷 수신
+//  range_start(start, length)       범위 분배(메인서버) / 탐색 시작(작업서버)
+//  range_end(start, length, result) 범위 완료(메인서버) / 탐색 종료(작업서버). result는 POW_* 또는 0
+//  hit(nonce)                       정답 발견
+//  stop(fd)                         중단 요청 송신(메인서버) / 수신(작업서버)
+#if !defined(POW_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define POW_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef POW_HAVE_USDT
+#define TRACE_PROBE1(name, a) DTRACE_PROBE1(pow, name, a)
+#define TRACE_PROBE2(name, a, b) DTRACE_PROBE2(pow, name, a, b)
+#define TRACE_PROBE3(name, a, b, c) DTRACE_PROBE3(pow, name, a, b, c)
+#else
+#define TRACE_PROBE1(name, a) do { (void)(a); } while (0)
+#define TRACE_PROBE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#define TRACE_PROBE3(name, a, b, c) do { (void)(a); (void)(b); (void)(c); } while (0)
+#endif
+
+#define PERF_COUNTER_COUNT 3  // 사이클, 명령어, 분기 예측 실패
+
+// 하드웨어 성능 카운터 측정값
+typedef struct _Perf_Sample {
+  unsigned long long cycles;
+  unsigned long long instructions;
+  unsigned long long branchMisses;
+} perf_sample;
+
+// 스레드 하나의 성능 카운터. 카운터를 연 스레드에서만 센다
+typedef struct _Perf_Counters {
+  int fd[PERF_COUNTER_COUNT];  // 열지 못한 카운터는 -1
+} perf_counters;
+
+/// @brief 호출한 스레드의 성능 카운터를 연다. 커널 설정(perf_event_paranoid)에 따라 일부 또는 전부 실패할 수 있다
+/// @param counters 성능 카운터
+/// @return 하나라도 열었으면 0, 모두 실패하면 -1
+int perf_counters_open(perf_counters* counters);
+
+/// @brief 카운터를 0으로 만들고 측정을 시작한다
+void perf_counters_start(perf_counters* counters);
+
+/// @brief 측정을 멈추고 시작 이후의 값을 sample에 더한다. 열지 못한 카운터는 더하지 않는다
+void perf_counters_stop(perf_counters* counters, perf_sample* sample);
+
+/// @brief 성능 카운터를 닫는다
+void perf_counters_close(perf_counters* counters);
+
+#endif
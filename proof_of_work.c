@@ -1,12 +1,13 @@
 #include <string.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <openssl/sha.h>
-
-#define POW_SUCCESS 0
-#define POW_NOTFOUND -1
-#define POW_TERMINATED -2
+#include "proof_of_work.h"
+#include "sha256_kernels.h"
+#include "blake3_kernels.h"
 
 volatile bool terminateFindNonce = false;
+bool useSearchKernels = true;
 
 void sha256_hash_string(const unsigned char *inputString, char outputBuffer[65])
 {
@@ -24,35 +25,272 @@ void sha256_hash_string(const unsigned char *inputString, char outputBuffer[65])
     outputBuffer[64] = '\0';
 }
 
+/**
+ * @brief 해시 결과를 16진수 문자열로 변환하는 함수이다.
+ */
+static void toHexString(const unsigned char hash[SHA256_DIGEST_LENGTH], char outputBuffer[65])
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        outputBuffer[i * 2] = digits[hash[i] >> 4];
+        outputBuffer[i * 2 + 1] = digits[hash[i] & 0x0f];
+    }
+    outputBuffer[64] = '\0';
+}
+
+static void sha256Init(pow_context* context, const char* challenge, size_t length)
+{
+    SHA256_Init(&context->base.sha256);
+    SHA256_Update(&context->base.sha256, challenge, length);
+}
+
+static void sha256HashNonce(const pow_context* context, const char* nonce, size_t length, unsigned char digest[32])
+{
+    SHA256_CTX sha256Context = context->base.sha256;
+    SHA256_Update(&sha256Context, nonce, length);
+    SHA256_Final(digest, &sha256Context);
+}
+
+static void sha256dHashNonce(const pow_context* context, const char* nonce, size_t length, unsigned char digest[32])
+{
+    unsigned char inner[SHA256_DIGEST_LENGTH];
+    sha256HashNonce(context, nonce, length, inner);
+    SHA256(inner, sizeof(inner), digest);
+}
+
+static void blake3Init(pow_context* context, const char* challenge, size_t length)
+{
+    blake3_hasher_init(&context->base.blake3);
+    blake3_hasher_update(&context->base.blake3, challenge, length);
+}
+
+static void blake3HashNonce(const pow_context* context, const char* nonce, size_t length, unsigned char digest[32])
+{
+    blake3_hasher hasher;
+    blake3_hasher_copy(&hasher, &context->base.blake3);
+    blake3_hasher_update(&hasher, nonce, length);
+    blake3_hasher_finalize(&hasher, digest);
+}
+
+// POW_HASH_* 순서의 해시 알고리즘 구현 표
+static const pow_backend backends[POW_HASH_COUNT] = {
+    { "sha256", true, 1, false, sha256Init, sha256HashNonce },
+    { "sha256d", true, 2, false, sha256Init, sha256dHashNonce },
+    { "blake3", false, 0, true, blake3Init, blake3HashNonce },
+};
+
+const pow_backend* pow_get_backend(int algorithm)
+{
+    if (algorithm < 0 || algorithm >= POW_HASH_COUNT) {
+        return NULL;
+    }
+    return &backends[algorithm];
+}
+
+int pow_find_backend(const char* name)
+{
+    for (int i = 0; i < POW_HASH_COUNT; i++) {
+        if (strcmp(backends[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int pow_context_init(pow_context* context, int algorithm, const char* challenge, size_t length)
+{
+    context->backend = pow_get_backend(algorithm);
+    if (context->backend == NULL) {
+        return -1;
+    }
+    context->backend->init(context, challenge, length);
+    return 0;
+}
+
+size_t pow_midstate(const char* challenge, size_t length, unsigned int midstate[8])
+{
+    SHA256_CTX sha256Context;
+    size_t prefixLength = length - length % SHA256_CBLOCK;
+
+    SHA256_Init(&sha256Context);
+    SHA256_Update(&sha256Context, challenge, prefixLength);
+    memcpy(midstate, sha256Context.h, sizeof(sha256Context.h));
+    return prefixLength;
+}
+
+int pow_context_resume(pow_context* context, int algorithm, const unsigned int midstate[8], unsigned long long prefixLength, const char* tail, size_t tailLength)
+{
+    context->backend = pow_get_backend(algorithm);
+    if (context->backend == NULL || !context->backend->hasMidstate) {
+        return -1;
+    }
+
+    // 블록 경계까지 처리된 상태이므로 버퍼는 비어 있고, 처리된 길이(비트)만 복원하면 된다.
+    SHA256_CTX* sha256Context = &context->base.sha256;
+    SHA256_Init(sha256Context);
+    memcpy(sha256Context->h, midstate, sizeof(sha256Context->h));
+    sha256Context->Nl = (unsigned int)(prefixLength << 3);
+    sha256Context->Nh = (unsigned int)(prefixLength >> 29);
+    SHA256_Update(sha256Context, tail, tailLength);
+    return 0;
+}
+
+void pow_hash_nonce(const pow_context* context, unsigned int nonce, char hashresult[65])
+{
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    char nonceString[16];
+
+    // challenge + nonce 문자열에서 nonce 부분만 추가로 해시한다.
+    int length = sprintf(nonceString, "%u", nonce);
+    context->backend->hashNonce(context, nonceString, length, hash);
+    toHexString(hash, hashresult);
+}
+
+int hashDifficulty(const char hash[65]){
+    int zeros = 0;
+    while (zeros < 64 && hash[zeros] == '0') {
+        zeros++;
+    }
+    return zeros;
+}
+
+bool verifyNonce(const char * challenge, unsigned int nonce, int difficulty, int algorithm, char hashresult[65]){
+    pow_context context;
+    if (pow_context_init(&context, algorithm, challenge, strlen(challenge)) != 0) {
+        sprintf(hashresult, "failed");
+        return false;
+    }
+    pow_hash_nonce(&context, nonce, hashresult);
+    return hashDifficulty(hashresult) >= difficulty;
+}
+
 int findNonce(unsigned int* nonce, char hashresult[65], const char * challenge, int difficulty, unsigned int startNonce, unsigned int nonceRange){
+    pow_context context;
+    pow_context_init(&context, POW_HASH_SHA256, challenge, strlen(challenge));
+    int res = findNonceUntil(nonce, hashresult, &context, difficulty, startNonce, nonceRange, NULL);
+    if (res == POW_SUCCESS) {
+        printf("Nonce found: %d\n", *nonce);
+    }
+    else if (res == POW_NOTFOUND) {
+        printf("Nonce is not this range\n");
+    }
+    return res;
+}
+
+// 범위 하나를 탐색하기 위해 준비한 특화 커널
+typedef struct {
+    bool isBlake3;
+    union {
+        sha256_kernel_job sha256;
+        blake3_kernel_job blake3;
+    } job;
+} SearchKernel;
+
+/**
+ * @brief 해시 알고리즘에 맞는 특화 커널을 준비하는 함수이다.
+ * @return 특화 커널을 쓸 수 없으면 false. 이때는 범용 경로로 탐색한다
+ */
+static bool prepareKernel(SearchKernel* kernel, const pow_context * context, int difficulty)
+{
+    if (!useSearchKernels) {
+        return false;
+    }
+    // SHA-256 계열은 범위마다 특화 커널을 고른다.
+    if (context->backend->kernelRounds > 0) {
+        kernel->isBlake3 = false;
+        sha256_kernel_prepare(&kernel->job.sha256, &context->base.sha256, context->backend->kernelRounds, difficulty);
+        return true;
+    }
+    // BLAKE3는 챌린지와 nonce가 첫 청크 안에 들어갈 때 레인 커널을 쓴다.
+    if (context->backend->hasLaneKernel) {
+        kernel->isBlake3 = true;
+        return blake3_kernel_prepare(&kernel->job.blake3, &context->base.blake3, difficulty);
+    }
+    return false;
+}
+
+static int kernelSearch(const SearchKernel* kernel, unsigned int* nonce, char hashresult[65], unsigned int startNonce, unsigned long long nonceRange, const volatile bool* cancel)
+{
+    if (kernel->isBlake3) {
+        return blake3_kernel_search(&kernel->job.blake3, nonce, hashresult, startNonce, nonceRange, cancel);
+    }
+    return sha256_kernel_search(&kernel->job.sha256, nonce, hashresult, startNonce, nonceRange, cancel);
+}
+
+int findNonceUntil(unsigned int* nonce, char hashresult[65], const pow_context * context, int difficulty, unsigned int startNonce, unsigned int nonceRange, const volatile bool* cancel){
     char hash[65];
+    SearchKernel kernel;
+
+    if (prepareKernel(&kernel, context, difficulty)) {
+        return kernelSearch(&kernel, nonce, hashresult, startNonce, nonceRange, cancel);
+    }
 
     // 난이도에 부합하는 비교용 문자열 생성
     char target[difficulty + 1];
     memset(target, '0', difficulty);
     target[difficulty] = '\0';
 
-    for(int i = 0; i < nonceRange; i++){
-        if (terminateFindNonce) {
+    for(unsigned int i = 0; i < nonceRange; i++){
+        if (terminateFindNonce || (cancel != NULL && *cancel)) {
           return POW_TERMINATED;
         }
-        char inputString[100];
-        // challenge + nonce 문자열
-        sprintf(inputString, "%s%d", challenge, startNonce+i);
-
-        // 해시값 계산
-        sha256_hash_string((const unsigned char *)inputString, hash);
+        // 챌린지가 반영된 해시 상태에 nonce를 더해 해시값 계산
+        pow_hash_nonce(context, startNonce + i, hash);
 
         //hash값이 난이도 조건을 충족하는 경우
         if (strncmp(hash, target, difficulty) == 0) {
-            printf("Nonce found: %d\n", startNonce+i);
             *nonce = startNonce + i;
             strcpy(hashresult, hash);
             return POW_SUCCESS;
         }
     }
-    printf("Nonce is not this range\n");
     *nonce = -1;
     sprintf(hashresult, "failed");
     return POW_NOTFOUND;
-}
\ No newline at end of file
+}
+
+int findAllNonces(const pow_context * context, int difficulty, unsigned int startNonce, unsigned int nonceRange, pow_hit_callback onHit, void* arg, const volatile bool* cancel){
+    char hash[65];
+    int found = 0;
+    SearchKernel kernel;
+
+    // 특화 커널로 다음 정답을 찾고, 찾은 nonce의 다음부터 이어서 탐색한다.
+    if (prepareKernel(&kernel, context, difficulty)) {
+        unsigned long long next = startNonce;
+        unsigned long long end = (unsigned long long)startNonce + nonceRange;
+        unsigned int nonce;
+        while (next < end) {
+            int res = kernelSearch(&kernel, &nonce, hash, next, end - next, cancel);
+            if (res == POW_TERMINATED) {
+                return POW_TERMINATED;
+            }
+            if (res == POW_NOTFOUND) {
+                break;
+            }
+            onHit(nonce, hash, arg);
+            found++;
+            next = (unsigned long long)nonce + 1;
+        }
+        return found > 0 ? POW_SUCCESS : POW_NOTFOUND;
+    }
+
+    // 난이도에 부합하는 비교용 문자열 생성
+    char target[difficulty + 1];
+    memset(target, '0', difficulty);
+    target[difficulty] = '\0';
+
+    for(unsigned int i = 0; i < nonceRange; i++){
+        if (terminateFindNonce || (cancel != NULL && *cancel)) {
+          return POW_TERMINATED;
+        }
+        // 챌린지가 반영된 해시 상태에 nonce를 더해 해시값 계산
+        pow_hash_nonce(context, startNonce + i, hash);
+
+        // 첫 정답에서 멈추지 않고 찾을 때마다 전달한다.
+        if (strncmp(hash, target, difficulty) == 0) {
+            onHit(startNonce + i, hash, arg);
+            found++;
+        }
+    }
+    return found > 0 ? POW_SUCCESS : POW_NOTFOUND;
+}
@@ -4,19 +4,107 @@
 #include <string.h>
 #include <stdbool.h>
 #include <openssl/evp.h>
+#include <openssl/sha.h>
+#include "blake3.h"
 
 #define POW_SUCCESS 0
 #define POW_NOTFOUND -1
 #define POW_TERMINATED -2
+#define POW_ERROR -3  // 탐색을 시작하지 못함 (잘못된 작업 옵션, 메모리 부족)
+
+#define POW_HASH_SHA256 0   // 해시 알고리즘: SHA-256
+#define POW_HASH_SHA256D 1  // 해시 알고리즘: 이중 SHA-256. SHA-256(SHA-256(challenge + nonce)) (32바이트 다이제스트를 다시 해시)
+#define POW_HASH_BLAKE3 2   // 해시 알고리즘: BLAKE3 (32바이트 출력)
+#define POW_HASH_COUNT 3
 
 extern volatile bool terminateFindNonce;
+extern bool useSearchKernels;  // false이면 특화 커널 없이 범용 탐색 경로만 사용한다
+
+typedef struct _POW_Context pow_context;
+
+/// @brief 해시 알고리즘 구현. 탐색 함수들은 작업마다 선택된 구현을 통해 해시값을 계산한다
+typedef struct _POW_Backend {
+    const char* name;
+    bool hasMidstate;   // SHA-256 중간 상태에서 이어서 해시할 수 있는지 여부
+    int kernelRounds;   // 특화 커널로 탐색할 때 SHA-256 적용 횟수. 0이면 SHA-256 특화 커널을 쓰지 않는다
+    bool hasLaneKernel; // nonce 여러 개를 SIMD 레인에 나누어 해시하는 BLAKE3 커널로 탐색할 수 있는지 여부
+    void (*init)(pow_context* context, const char* challenge, size_t length);
+    void (*hashNonce)(const pow_context* context, const char* nonce, size_t length, unsigned char digest[32]);
+} pow_backend;
+
+/// @brief 챌린지를 미리 반영해 둔 해시 상태. nonce마다 이 상태를 복사하여 nonce 문자열만 추가로 해시한다
+struct _POW_Context {
+    const pow_backend* backend;
+    union {
+        SHA256_CTX sha256;
+        blake3_hasher blake3;
+    } base;
+};
+
+/// @brief 난이도를 만족하는 nonce를 찾을 때마다 호출되는 콜백
+typedef void (*pow_hit_callback)(unsigned int nonce, const char hash[65], void* arg);
 
 /// @brief sha256을 사용하여 hash값을 버퍼에 저장
 /// @param inputString 
 /// @param outputBuffer 
 void sha256_hash_string(const unsigned char *inputString, char outputBuffer[65]);
 
-/// @brief 난이도에 맞는 nonce를 찾아서 반환
+/// @brief 해시 알고리즘 구현을 반환한다
+/// @param algorithm 해시 알고리즘 (POW_HASH_*)
+/// @return 지원하지 않는 알고리즘이면 NULL
+const pow_backend* pow_get_backend(int algorithm);
+
+/// @brief 이름으로 해시 알고리즘을 찾는다
+/// @param name "sha256", "sha256d", "blake3"
+/// @return 해시 알고리즘 (POW_HASH_*). 없으면 -1
+int pow_find_backend(const char* name);
+
+/// @brief 챌린지 전체를 해시 상태에 반영한다
+/// @param context 초기화할 해시 상태
+/// @param algorithm 해시 알고리즘 (POW_HASH_*)
+/// @param challenge 챌린지
+/// @param length 챌린지 길이
+/// @return 성공 시 0, 지원하지 않는 알고리즘이면 -1
+int pow_context_init(pow_context* context, int algorithm, const char* challenge, size_t length);
+
+/// @brief 챌린지 앞부분의 64바이트 블록들을 해시한 SHA-256 중간 상태(midstate)를 계산한다
+/// @param challenge 챌린지
+/// @param length 챌린지 길이
+/// @param midstate 중간 상태 반환 버퍼
+/// @return 중간 상태에 반영된 앞부분의 길이 (64의 배수). 나머지 꼬리는 64바이트 미만이다
+size_t pow_midstate(const char* challenge, size_t length, unsigned int midstate[8]);
+
+/// @brief 중간 상태에서 해시 상태를 복원한 뒤 챌린지의 나머지 꼬리를 반영한다
+/// @param context 초기화할 해시 상태
+/// @param algorithm 해시 알고리즘 (POW_HASH_*). SHA-256 계열만 중간 상태를 지원한다
+/// @param midstate pow_midstate로 계산한 중간 상태
+/// @param prefixLength 중간 상태에 반영된 앞부분의 길이 (64의 배수)
+/// @param tail 챌린지의 나머지 꼬리
+/// @param tailLength 꼬리 길이
+/// @return 성공 시 0, 중간 상태를 지원하지 않는 알고리즘이면 -1
+int pow_context_resume(pow_context* context, int algorithm, const unsigned int midstate[8], unsigned long long prefixLength, const char* tail, size_t tailLength);
+
+/// @brief 챌린지 + nonce의 해시값을 계산한다
+/// @param context 챌린지를 반영한 해시 상태
+/// @param nonce nonce
+/// @param hashresult 16진수 해시 문자열 반환 버퍼
+void pow_hash_nonce(const pow_context* context, unsigned int nonce, char hashresult[65]);
+
+/// @brief 해시값 앞의 '0' 개수, 즉 해시값이 만족하는 최대 난이도를 반환
+/// @param hash 16진수 해시 문자열
+/// @return 선행 '0'의 개수
+int hashDifficulty(const char hash[65]);
+
+/// @brief 챌린지와 nonce의 해시값을 계산하여 난이도를 만족하는지 검증
+/// @param challenge 챌린지 문자열
+/// @param nonce 검증할 nonce
+/// @param difficulty 난이도 정수
+/// @param algorithm 해시 알고리즘 (POW_HASH_*)
+/// @param hashresult 계산된 해시값 반환 버퍼
+/// @return 난이도를 만족하면 true
+bool verifyNonce(const char * challenge, unsigned int nonce, int difficulty, int algorithm, char hashresult[65]);
+
+/// @brief 난이도에 맞는 nonce를 SHA-256으로 찾아서 반환
 /// @param nonce 찾은 nonce 정수
 /// @param hashresult 정답 nonce의 hash값 반환 버퍼
 /// @param challenge 챌린지 문자열
@@ -26,4 +114,21 @@ void sha256_hash_string(const unsigned char *inputString, char outputBuffer[65])
 /// @return 
 int findNonce(unsigned int* nonce, char hashresult[65], const char * challenge, int difficulty, unsigned int startNonce, unsigned int nonceRange);
 
+/// @brief findNonce와 같지만 결과를 출력하지 않고, cancel이 설정되면 중단한다
+/// @param context 챌린지를 반영한 해시 상태
+/// @param cancel 중단 플래그. NULL이면 terminateFindNonce만 확인
+/// @return findNonce와 같다
+int findNonceUntil(unsigned int* nonce, char hashresult[65], const pow_context * context, int difficulty, unsigned int startNonce, unsigned int nonceRange, const volatile bool* cancel);
+
+/// @brief 범위 안에서 난이도에 맞는 모든 nonce를 찾아 콜백으로 전달
+/// @param context 챌린지를 반영한 해시 상태
+/// @param difficulty 난이도 정수
+/// @param startNonce 시작 nonce값
+/// @param nonceRange nonce 범위
+/// @param onHit 찾은 nonce마다 호출되는 콜백
+/// @param arg 콜백에 전달되는 인자
+/// @param cancel 중단 플래그. NULL이면 terminateFindNonce만 확인
+/// @return 하나 이상 찾은 경우 POW_SUCCESS, 없으면 POW_NOTFOUND, 중단된 경우 POW_TERMINATED
+int findAllNonces(const pow_context * context, int difficulty, unsigned int startNonce, unsigned int nonceRange, pow_hit_callback onHit, void* arg, const volatile bool* cancel);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <openssl/sha.h>
+#include "proof_of_work.h"
+#include "result_cache.h"
+
+/**
+ * @brief 해시 알고리즘과 챌린지로 캐시 키를 만드는 함수이다.
+ * SHA-256 정답은 알고리즘 구분이 추가되기 전의 캐시 파일과 호환되도록 챌린지만으로 키를 만든다.
+ */
+static void makeKey(const char* challenge, int algorithm, unsigned char key[32])
+{
+  SHA256_CTX sha256Context;
+  SHA256_Init(&sha256Context);
+  if (algorithm != POW_HASH_SHA256) {
+    const pow_backend* backend = pow_get_backend(algorithm);
+    SHA256_Update(&sha256Context, backend->name, strlen(backend->name) + 1);
+  }
+  SHA256_Update(&sha256Context, challenge, strlen(challenge));
+  SHA256_Final(key, &sha256Context);
+}
+
+/**
+ * @brief 챌린지의 다이제스트로부터 첫 번째 탐색 슬롯 번호를 구하는 함수이다.
+ */
+static unsigned int homeSlot(const result_cache* cache, const unsigned char key[32])
+{
+  unsigned int slot;
+  memcpy(&slot, key, sizeof(slot));
+  return slot % cache->header->capacity;
+}
+
+int result_cache_open(result_cache* cache, const char* path)
+{
+  size_t size = sizeof(result_cache_header) + (size_t)RESULT_CACHE_CAPACITY * sizeof(result_cache_entry);
+
+  memset(cache, 0, sizeof(*cache));
+  cache->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (cache->fd < 0) {
+    return -1;
+  }
+
+  // 파일 크기가 맞지 않으면 새 캐시 파일로 초기화한다.
+  struct stat st;
+  bool isNew = fstat(cache->fd, &st) != 0 || (size_t)st.st_size != size;
+  if (isNew && ftruncate(cache->fd, 0) == -1) {
+    close(cache->fd);
+    return -1;
+  }
+  if (isNew && ftruncate(cache->fd, size) == -1) {
+    close(cache->fd);
+    return -1;
+  }
+
+  void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, cache->fd, 0);
+  if (map == MAP_FAILED) {
+    close(cache->fd);
+    return -1;
+  }
+  cache->size = size;
+  cache->header = (result_cache_header*)map;
+  cache->entries = (result_cache_entry*)((char*)map + sizeof(result_cache_header));
+
+  if (isNew || cache->header->magic != RESULT_CACHE_MAGIC || cache->header->version != RESULT_CACHE_VERSION
+      || cache->header->capacity != RESULT_CACHE_CAPACITY) {
+    memset(map, 0, size);
+    cache->header->magic = RESULT_CACHE_MAGIC;
+    cache->header->version = RESULT_CACHE_VERSION;
+    cache->header->capacity = RESULT_CACHE_CAPACITY;
+  }
+  return 0;
+}
+
+bool result_cache_lookup(const result_cache* cache, const char* challenge, int algorithm, int difficulty, unsigned int* nonce, char hash[65])
+{
+  unsigned char key[32];
+  makeKey(challenge, algorithm, key);
+
+  unsigned int slot = homeSlot(cache, key);
+  for (int i = 0; i < RESULT_CACHE_PROBE; i++) {
+    const result_cache_entry* entry = &cache->entries[(slot + i) % cache->header->capacity];
+    if (!entry->used) {
+      return false;
+    }
+    if (memcmp(entry->key, key, sizeof(key)) == 0) {
+      if (entry->difficulty < difficulty) {
+        return false;
+      }
+      *nonce = entry->nonce;
+      memcpy(hash, entry->hash, 64);
+      hash[64] = '\0';
+      return true;
+    }
+  }
+  return false;
+}
+
+int result_cache_store(result_cache* cache, const char* challenge, int algorithm, unsigned int nonce, const char hash[65])
+{
+  unsigned char key[32];
+  makeKey(challenge, algorithm, key);
+
+  // 같은 챌린지의 슬롯이나 빈 슬롯을 찾는다. 없으면 난이도가 가장 낮은 슬롯을 교체한다.
+  unsigned int slot = homeSlot(cache, key);
+  result_cache_entry* victim = NULL;
+  for (int i = 0; i < RESULT_CACHE_PROBE; i++) {
+    result_cache_entry* entry = &cache->entries[(slot + i) % cache->header->capacity];
+    if (!entry->used || memcmp(entry->key, key, sizeof(key)) == 0) {
+      victim = entry;
+      break;
+    }
+    if (victim == NULL || entry->difficulty < victim->difficulty) {
+      victim = entry;
+    }
+  }
+
+  int difficulty = hashDifficulty(hash);
+  bool isSame = victim->used && memcmp(victim->key, key, sizeof(key)) == 0;
+  if (isSame && victim->difficulty >= difficulty) {
+    return 1;
+  }
+  if (!victim->used) {
+    cache->header->count++;
+  }
+
+  memcpy(victim->key, key, sizeof(key));
+  victim->nonce = nonce;
+  victim->difficulty = difficulty;
+  memcpy(victim->hash, hash, 64);
+  victim->used = 1;
+
+  msync(cache->header, cache->size, MS_ASYNC);
+  return 0;
+}
+
+void result_cache_close(result_cache* cache)
+{
+  if (cache->header != NULL) {
+    msync(cache->header, cache->size, MS_SYNC);
+    munmap(cache->header, cache->size);
+    cache->header = NULL;
+  }
+  if (cache->fd >= 0) {
+    close(cache->fd);
+    cache->fd = -1;
+  }
+}
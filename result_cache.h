@@ -0,0 +1,63 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define RESULT_CACHE_MAGIC 0x43505744 // "DWPC"
+#define RESULT_CACHE_VERSION 1
+#define RESULT_CACHE_CAPACITY 65536 // 캐시 파일의 슬롯 수
+#define RESULT_CACHE_PROBE 16 // 한 챌린지에 대해 탐색하는 최대 슬롯 수
+
+typedef struct _Result_Cache_Header {
+  unsigned int magic;
+  unsigned int version;
+  unsigned int capacity;
+  unsigned int count;
+} result_cache_header;
+
+typedef struct _Result_Cache_Entry {
+  unsigned char key[32];      // 해시 알고리즘과 챌린지의 SHA-256 다이제스트
+  unsigned int nonce;         // 정답 nonce
+  unsigned char difficulty;   // 정답 해시값이 만족하는 최대 난이도 (선행 '0'의 개수)
+  unsigned char used;         // 사용 중인 슬롯인지 여부
+  char hash[64];              // 정답 해시값 ('\0' 제외)
+} result_cache_entry;
+
+typedef struct _Result_Cache {
+  int fd;
+  size_t size;
+  result_cache_header* header;
+  result_cache_entry* entries;
+} result_cache;
+
+/// @brief 캐시 파일을 열어 메모리에 매핑한다. 파일이 없거나 형식이 맞지 않으면 새로 만든다
+/// @param cache 캐시 구조체
+/// @param path 캐시 파일 경로
+/// @return 성공 시 0, 실패 시 -1
+int result_cache_open(result_cache* cache, const char* path);
+
+/// @brief 챌린지에 대해 난이도 이상을 만족하는 정답을 찾는다
+/// 더 높은 난이도의 정답은 낮은 난이도도 만족하므로 그대로 반환된다.
+/// @param cache 캐시 구조체
+/// @param challenge 챌린지 문자열
+/// @param algorithm 해시 알고리즘 (POW_HASH_*)
+/// @param difficulty 요청 난이도
+/// @param nonce 찾은 정답 nonce
+/// @param hash 찾은 정답의 해시값
+/// @return 찾으면 true
+bool result_cache_lookup(const result_cache* cache, const char* challenge, int algorithm, int difficulty, unsigned int* nonce, char hash[65]);
+
+/// @brief 챌린지의 정답을 저장한다. 이미 더 높은 난이도의 정답이 있으면 저장하지 않는다
+/// @param cache 캐시 구조체
+/// @param challenge 챌린지 문자열
+/// @param algorithm 해시 알고리즘 (POW_HASH_*)
+/// @param nonce 정답 nonce
+/// @param hash 정답의 해시값
+/// @return 저장한 경우 0, 저장하지 않은 경우 1, 실패 시 -1
+int result_cache_store(result_cache* cache, const char* challenge, int algorithm, unsigned int nonce, const char hash[65]);
+
+/// @brief 캐시 파일의 매핑을 해제하고 닫는다
+void result_cache_close(result_cache* cache);
+
+#endif
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <openssl/sha.h>
+#include "proof_of_work.h"
+#include "sha256_kernels.h"
+
+// 범용 탐색 경로는 nonce마다 SHA256_Update/SHA256_Final로 길이와 패딩을 처리하고 해시값을 16진수로 바꾸어 비교한다.
+// 특화 커널은 (SHA-256 적용 횟수, 마지막 블록 수, nonce 자릿수)마다 따로 생성되어, 범위를 시작할 때
+// 챌린지 꼬리, nonce 자리, 패딩, 길이 워드를 블록에 한 번만 채워 두고 nonce마다 10진수 자리만 올리며
+// SHA256_Transform을 정해진 횟수만큼 호출한다. 난이도는 해시 워드에서 직접 비교한다.
+
+#define CANCEL_CHECK_MASK 0xFF  // 중단 플래그를 확인하는 주기 (nonce 수 - 1)
+
+static const unsigned int IV[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+// 이중 SHA-256의 두 번째 블록에서 32바이트 다이제스트 뒤에 붙는 패딩과 길이(256비트)
+static const unsigned char DIGEST_PADDING[32] = {
+  0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0x00,
+};
+
+static inline void store32(unsigned char* p, unsigned int value)
+{
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+static inline bool isCancelled(const volatile bool* cancel)
+{
+  return terminateFindNonce || (cancel != NULL && *cancel);
+}
+
+static inline bool meetsDifficulty(const sha256_kernel_job* job, const unsigned int h[8])
+{
+  for (int i = 0; i < job->zeroWords; i++) {
+    if (h[i] != 0) {
+      return false;
+    }
+  }
+  return job->zeroMask == 0 || (h[job->zeroWords] & job->zeroMask) == 0;
+}
+
+static void toHexString(const unsigned int h[8], char hashresult[65])
+{
+  for (int i = 0; i < 8; i++) {
+    sprintf(hashresult + i * 8, "%08x", h[i]);
+  }
+  hashresult[64] = '\0';
+}
+
+/**
+ * @brief 이중 SHA-256의 두 번째 해시를 계산하는 함수이다. 첫 해시값을 한 블록에 담아 IV에서 다시 압축한다.
+ */
+static inline void rehash(SHA256_CTX* c)
+{
+  unsigned char block[SHA256_CBLOCK];
+  for (int i = 0; i < 8; i++) {
+    store32(block + i * 4, c->h[i]);
+  }
+  memcpy(block + 32, DIGEST_PADDING, sizeof(DIGEST_PADDING));
+  memcpy(c->h, IV, sizeof(c->h));
+  SHA256_Transform(c, block);
+}
+
+/**
+ * @brief 마지막 블록들에 챌린지 꼬리, 시작 nonce의 10진수 문자열, 패딩, 메시지 길이를 채우는 함수이다.
+ */
+static void fillBlocks(const sha256_kernel_job* job, unsigned char* block, int blocks, int digits, unsigned int start)
+{
+  int size = blocks * SHA256_CBLOCK;
+  memset(block, 0, size);
+  memcpy(block, job->tail, job->tailLength);
+  for (int i = digits - 1; i >= 0; i--) {
+    block[job->tailLength + i] = '0' + start % 10;
+    start /= 10;
+  }
+  block[job->tailLength + digits] = 0x80;
+
+  unsigned long long bits = (job->challengeLength + digits) * 8;
+  store32(block + size - 8, (unsigned int)(bits >> 32));
+  store32(block + size - 4, (unsigned int)bits);
+}
+
+// nonce 자릿수(DIGITS)가 모두 같은 범위 [start, start + count)를 탐색하는 커널을 정의한다.
+// 블록 안의 10진수 nonce는 끝자리부터 올림하며 증가시킨다.
+#define DEFINE_KERNEL(ROUNDS, BLOCKS, DIGITS) \
+static int kernel_##ROUNDS##_##BLOCKS##_##DIGITS(const sha256_kernel_job* job, unsigned int start, unsigned int count, \
+    unsigned int* nonce, char hashresult[65], const volatile bool* cancel) \
+{ \
+  unsigned char block[BLOCKS * SHA256_CBLOCK]; \
+  unsigned char* digits = block + job->tailLength; \
+  SHA256_CTX c; \
+  fillBlocks(job, block, BLOCKS, DIGITS, start); \
+  for (unsigned int i = 0; i < count; i++) { \
+    if ((i & CANCEL_CHECK_MASK) == 0 && isCancelled(cancel)) { \
+      return POW_TERMINATED; \
+    } \
+    memcpy(c.h, job->h, sizeof(c.h)); \
+    SHA256_Transform(&c, block); \
+    if (BLOCKS == 2) { \
+      SHA256_Transform(&c, block + SHA256_CBLOCK); \
+    } \
+    if (ROUNDS == 2) { \
+      rehash(&c); \
+    } \
+    if (meetsDifficulty(job, c.h)) { \
+      *nonce = start + i; \
+      toHexString(c.h, hashresult); \
+      return POW_SUCCESS; \
+    } \
+    for (int j = DIGITS - 1; j >= 0; j--) { \
+      if (digits[j] != '9') { \
+        digits[j]++; \
+        break; \
+      } \
+      digits[j] = '0'; \
+    } \
+  } \
+  return POW_NOTFOUND; \
+}
+
+#define DEFINE_KERNELS(ROUNDS, BLOCKS) \
+  DEFINE_KERNEL(ROUNDS, BLOCKS, 1) DEFINE_KERNEL(ROUNDS, BLOCKS, 2) \
+  DEFINE_KERNEL(ROUNDS, BLOCKS, 3) DEFINE_KERNEL(ROUNDS, BLOCKS, 4) \
+  DEFINE_KERNEL(ROUNDS, BLOCKS, 5) DEFINE_KERNEL(ROUNDS, BLOCKS, 6) \
+  DEFINE_KERNEL(ROUNDS, BLOCKS, 7) DEFINE_KERNEL(ROUNDS, BLOCKS, 8) \
+  DEFINE_KERNEL(ROUNDS, BLOCKS, 9) DEFINE_KERNEL(ROUNDS, BLOCKS, 10)
+
+#define KERNEL_ROW(ROUNDS, BLOCKS) { \
+  kernel_##ROUNDS##_##BLOCKS##_1, kernel_##ROUNDS##_##BLOCKS##_2, kernel_##ROUNDS##_##BLOCKS##_3, \
+  kernel_##ROUNDS##_##BLOCKS##_4, kernel_##ROUNDS##_##BLOCKS##_5, kernel_##ROUNDS##_##BLOCKS##_6, \
+  kernel_##ROUNDS##_##BLOCKS##_7, kernel_##ROUNDS##_##BLOCKS##_8, kernel_##ROUNDS##_##BLOCKS##_9, \
+  kernel_##ROUNDS##_##BLOCKS##_10 }
+
+DEFINE_KERNELS(1, 1)
+DEFINE_KERNELS(1, 2)
+DEFINE_KERNELS(2, 1)
+DEFINE_KERNELS(2, 2)
+
+typedef int (*KernelFunc)(const sha256_kernel_job*, unsigned int, unsigned int, unsigned int*, char[65], const volatile bool*);
+
+// [SHA-256 적용 횟수 - 1][마지막 블록 수 - 1][nonce 자릿수 - 1]
+static const KernelFunc kernels[2][2][SHA256_KERNEL_MAX_DIGITS] = {
+  { KERNEL_ROW(1, 1), KERNEL_ROW(1, 2) },
+  { KERNEL_ROW(2, 1), KERNEL_ROW(2, 2) },
+};
+
+void sha256_kernel_prepare(sha256_kernel_job* job, const SHA256_CTX* base, int rounds, int difficulty)
+{
+  memcpy(job->h, base->h, sizeof(job->h));
+  job->tailLength = base->num;
+  memcpy(job->tail, base->data, base->num);
+  job->challengeLength = (((unsigned long long)base->Nh << 32) | base->Nl) / 8;
+  job->rounds = rounds;
+
+  // 16진수 한 자리는 4비트이므로, 난이도만큼의 상위 비트가 0이어야 한다.
+  if (difficulty > 64) {
+    difficulty = 64;
+  }
+  job->zeroWords = difficulty / 8;
+  job->zeroMask = difficulty % 8 == 0 ? 0 : 0xFFFFFFFFu << (32 - difficulty % 8 * 4);
+}
+
+int sha256_kernel_search(const sha256_kernel_job* job, unsigned int* nonce, char hashresult[65], unsigned int startNonce, unsigned long long nonceRange, const volatile bool* cancel)
+{
+  unsigned long long next = startNonce;
+  unsigned long long end = startNonce + nonceRange;
+
+  // 범위를 nonce 자릿수가 같은 구간으로 나누어, 구간마다 커널을 한 번 고른다.
+  while (next < end) {
+    int digits = 1;
+    unsigned long long classEnd = 10;
+    while (next >= classEnd) {
+      digits++;
+      classEnd *= 10;
+    }
+    if (classEnd > end) {
+      classEnd = end;
+    }
+
+    int blocks = job->tailLength + digits + 9 <= SHA256_CBLOCK ? 1 : 2;
+    int res = kernels[job->rounds - 1][blocks - 1][digits - 1](job, next, classEnd - next, nonce, hashresult, cancel);
+    if (res != POW_NOTFOUND) {
+      return res;
+    }
+    next = classEnd;
+  }
+
+  *nonce = -1;
+  sprintf(hashresult, "failed");
+  return POW_NOTFOUND;
+}
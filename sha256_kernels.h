@@ -0,0 +1,37 @@
+#ifndef SHA256_KERNELS_H
+#define SHA256_KERNELS_H
+
+#include <stdbool.h>
+#include <openssl/sha.h>
+
+#define SHA256_KERNEL_MAX_DIGITS 10 // unsigned int nonce의 최대 10진수 자릿수
+
+// 범위 하나를 특화 커널로 탐색하기 위해 미리 계산해 둔 값
+typedef struct _SHA256_Kernel_Job {
+  unsigned int h[8];              // 챌린지의 64바이트 블록들을 반영한 중간 상태
+  unsigned char tail[SHA256_CBLOCK];  // 아직 블록을 채우지 못한 챌린지 꼬리
+  unsigned int tailLength;
+  unsigned long long challengeLength; // 챌린지 전체 길이 (바이트)
+  int rounds;                     // SHA-256 적용 횟수. 2이면 이중 SHA-256
+  int zeroWords;                  // 0이어야 하는 해시 워드 수
+  unsigned int zeroMask;          // 그다음 워드에서 0이어야 하는 비트
+} sha256_kernel_job;
+
+/// @brief 챌린지를 반영한 SHA-256 상태와 난이도로 커널 작업을 준비한다
+/// @param job 준비할 커널 작업
+/// @param base 챌린지를 반영한 SHA-256 상태
+/// @param rounds SHA-256 적용 횟수 (1 또는 2)
+/// @param difficulty 난이도 (해시값 앞의 '0' 개수)
+void sha256_kernel_prepare(sha256_kernel_job* job, const SHA256_CTX* base, int rounds, int difficulty);
+
+/// @brief 범위를 nonce 자릿수별로 나누고, (블록 수, 자릿수)에 맞는 특화 커널로 첫 번째 정답을 찾는다
+/// @param job sha256_kernel_prepare로 준비한 커널 작업
+/// @param nonce 찾은 nonce
+/// @param hashresult 찾은 nonce의 해시값
+/// @param startNonce 시작 nonce값
+/// @param nonceRange nonce 범위
+/// @param cancel 중단 플래그. NULL이면 terminateFindNonce만 확인
+/// @return findNonceUntil과 같다
+int sha256_kernel_search(const sha256_kernel_job* job, unsigned int* nonce, char hashresult[65], unsigned int startNonce, unsigned long long nonceRange, const volatile bool* cancel);
+
+#endif
@@ -36,32 +36,138 @@
 #include <pthread.h>
 #include "dwp.h"
 #include "proof_of_work.h"
+#include "cpu_topology.h"
+#include "hash_pool.h"
+#include "perf_trace.h"
+#include "logger.h"
 
 #define ISVALIDSOCKET(s) ((s) >= 0)
 #define CLOSESOCKET(s) close(s)
 #define SOCKET int
 #define GETSOCKETERRNO() (errno)
+#define WORK_QUEUE_SIZE DWP_BATCH_MAX  // 미리 받아 둘 수 있는 작업 요청의 최대 개수
+#define REPORT_QUEUE_SIZE 256  // 전송을 기다리는 보고의 최대 개수. 가득 차면 share 보고는 버리고 결과 보고는 자리가 날 때까지 기다린다
+
+// 모든 정답/상위 k개 탐색 모드에서 찾은 정답을 모아 두는 구조체
+typedef struct {
+  const dwp_job_option* option;
+  dwp_result* results;
+  int count;
+  int capacity;
+} ResultCollector;
+
+typedef struct {
+  unsigned int startNonce;  // 탐색 중인 범위
+  unsigned int workload;
+  unsigned int nonces[DWP_SHARE_BATCH];
+  int count;
+} ShareCollector;
+
+// 해시 스레드가 만든 보고 패킷. 해시 스레드가 전송을 기다리지 않도록 보고 전송 스레드가 차례로 보낸다
+typedef struct _Report {
+  dwp_packet packet;
+  struct _Report* next;
+} Report;
 
 void errProc(const char* str);
 void terminateFindNonceThread();
 void* readThread(void *);
 void* findNonceThread(void*);
+int makeContext(const dwp_packet*, const dwp_job_option*, pow_context*);
+void runShardJob(SOCKET, const dwp_packet*, const dwp_job_option*, const pow_context*);
+int collectNonces(const dwp_packet*, const dwp_job_option*, const pow_context*, unsigned int, unsigned int);
+void flushResults(ResultCollector*);
+void onNonceFound(unsigned int, const char[65], void*);
+void sendRangeDone(SOCKET, unsigned int, unsigned int);
+void sendRangeRejected(SOCKET, unsigned int, unsigned int);
+void endRange(unsigned int, unsigned int, int, bool);
+int searchRange(const dwp_job_option*, const pow_context*, int, unsigned int, unsigned int, unsigned int*, char[65]);
+void flushShares(ShareCollector*);
+void onShareFound(unsigned int, const char[65], void*);
+void* reportThread(void*);
+void queueReport(dwp_packet*);
+void waitReportsSent();
 
 static bool isFinished = false;
-static bool isWorkRequested = false;
-static dwp_packet packet;
+static bool usePerfCounters = false;  // 범위마다 하드웨어 성능 카운터를 측정하여 출력할지 여부
+static dwp_packet workQueue[WORK_QUEUE_SIZE];  // 수신한 작업 요청을 보관하는 원형 큐
+static int queueHead = 0;
+static int queueCount = 0;
 
 // 조건 변수와 뮤텍스 선언
 static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// 보고 전송 큐. 정답/share 콜백은 해시 풀의 뮤텍스를 잡은 채 호출되므로, 콜백에서는 큐에 넣기만 한다.
+// 큐의 크기는 REPORT_QUEUE_SIZE로 제한한다.
+static Report* reportHead = NULL;
+static Report* reportTail = NULL;
+static int reportCount = 0;
+static unsigned long long droppedShareReports = 0;  // 전송 큐가 가득 차서 버린 share 보고 수
+static bool isReportSending = false;  // 전송 스레드가 큐에서 꺼낸 보고를 보내는 중인지 여부
+static bool isReportShutdown = false;
+static pthread_cond_t reportCond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t reportMutex = PTHREAD_MUTEX_INITIALIZER;
+
 int main(int argc, char *argv[]) 
 {
+  // 옵션을 처리한다.
+  //  -t threads : 해시 스레드 수. 지정하지 않으면 물리 코어 수만큼
+  //  -H : SMT 형제(하이퍼스레드)도 해시 스레드에 사용
+  //  -P : 범위마다 하드웨어 성능 카운터(사이클, 명령어, 분기 예측 실패)를 측정하여 출력
+  int threadCount = 0;
+  bool useSmt = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:HP")) != -1) {
+    switch (opt) {
+      case 't':
+        threadCount = atoi(optarg);
+        break;
+      case 'H':
+        useSmt = true;
+        break;
+      case 'P':
+        usePerfCounters = true;
+        break;
+      default:
+        fprintf(stderr, ">> usage: working_server [-t threads] [-H] [-P] hostname port\n");
+        return -1;
+    }
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+
   if (argc < 3) {
-      fprintf(stderr, ">> usage: working_server hostname port\n");
+      fprintf(stderr, ">> usage: working_server [-t threads] [-H] [-P] hostname port\n");
       return -1;
   }
 
+  // 진행 상황 출력은 로그 출력 스레드가 맡아, 해시/네트워크 스레드가 콘솔 출력을 기다리지 않게 한다.
+  log_init();
+
+  // CPU 토폴로지를 읽어 해시 스레드는 물리 코어마다 하나씩, 네트워크 스레드는 해시 스레드가 없는 CPU에 배치한다.
+  static cpu_topology topology;
+  int hashCpus[TOPOLOGY_MAX_CPUS];
+  int ioCpu;
+  topology_discover(&topology);
+  threadCount = topology_plan(&topology, threadCount, useSmt, hashCpus, &ioCpu);
+  if (threadCount == 0) {
+    threadCount = 1;
+    hashCpus[0] = -1;
+  }
+  LOG_INFO(">> %d CPUs, %d cores, %d NUMA nodes", topology.cpuCount, topology.coreCount, topology.nodeCount);
+  LOG_INFO(">> %d hashing threads, network thread on CPU %d", threadCount, ioCpu);
+  if (hash_pool_init(threadCount, hashCpus, usePerfCounters) != 0) {
+    errProc("hash_pool_init");
+  }
+  perf_sample sample;
+  if (usePerfCounters && !hash_pool_sample(&sample)) {
+    LOG_WARN("## Performance counters are unavailable (see /proc/sys/kernel/perf_event_paranoid)");
+    usePerfCounters = false;
+  }
+  // 이후 생성되는 수신/작업 관리 스레드는 메인 스레드의 CPU 고정을 물려받는다.
+  topology_pin_self(ioCpu);
+
   // hostname과 port를 사용해서 메인서버의 주소를 구한다. 
   struct addrinfo hints;
   memset(&hints, 0, sizeof(hints));
@@ -86,22 +192,33 @@ int main(int argc, char *argv[])
   }
   freeaddrinfo(peer_address); // peer_address에 대한 메모리를 해제한다.
 
-  printf(">> Connected to main server\n");
+  LOG_INFO(">> Connected to main server");
 
-  memset(&packet, 0, sizeof(packet));
+  memset(workQueue, 0, sizeof(workQueue));
 
   // 서버로부터 메시지를 수신하는 작업과, nonce 값을 찾는 작업을 멀티스레드를 통해 동시에 수행한다.
-  pthread_t thread_read, thread_find_nonce;
+  // 탐색 중에 모인 정답/share 보고는 별도의 전송 스레드가 보낸다.
+  pthread_t thread_read, thread_find_nonce, thread_report;
   pthread_create(&thread_read, NULL, readThread, (void *)&serverSd);
   pthread_create(&thread_find_nonce, NULL, findNonceThread, (void *)&serverSd);
+  pthread_create(&thread_report, NULL, reportThread, (void *)&serverSd);
   pthread_join(thread_read, NULL);
   pthread_join(thread_find_nonce, NULL);
+  pthread_mutex_lock(&reportMutex);
+  isReportShutdown = true;
+  pthread_cond_broadcast(&reportCond);
+  pthread_mutex_unlock(&reportMutex);
+  pthread_join(thread_report, NULL);
+  hash_pool_destroy();
 
   // 자원을 반환한다.
   CLOSESOCKET(serverSd);
   pthread_mutex_destroy(&mutex);
   pthread_cond_destroy(&cond);
-  dwp_destroy(&packet);
+  for (int i = 0; i < WORK_QUEUE_SIZE; i++) {
+    dwp_destroy(&workQueue[i]);
+  }
+  log_shutdown();
   return 0;
 }
 
@@ -110,8 +227,10 @@ int main(int argc, char *argv[])
 */
 void errProc(const char* str)
 {
-	fprintf(stderr,"## %s: %s\n", str, strerror(errno));
-	exit(errno);
+	int err = errno;
+	log_flush();
+	fprintf(stderr,"## %s: %s\n", str, strerror(err));
+	exit(err);
 }
 
 /**
@@ -142,34 +261,42 @@ void* readThread(void* arg)
     // 메인서버에서 온 패킷이 있는지 확인한다.
     recvLen = dwp_recv(serverSd, &reqPacket);
     if (recvLen < 0) {
-      printf(">> Connection closed by main server.\n");
+      LOG_INFO(">> Connection closed by main server.");
       terminateFindNonceThread();
       break;
     }
 
     // 패킷이 응답(response) 패킷인 경우 무시한다.
     if (reqPacket.data.qr == DWP_QR_RESPONSE) {
-      fprintf(stderr, "## Invalid response packet.\n");
+      LOG_WARN("## Invalid response packet.");
       continue;
     }
 
     switch (reqPacket.data.type) {
       case DWP_TYPE_WORK: // 수신한 패킷이 작업 요청인 경우
-        printf(">> The work request is received\n");
+      case DWP_TYPE_EXT:  // 수신한 패킷이 옵션이 포함된 작업 요청인 경우
+        LOG_DEBUG(">> The work request is received");
         pthread_mutex_lock(&mutex);
-        pthread_cond_signal(&cond);
-        dwp_copy(&packet, &reqPacket);
-        isWorkRequested = true;
+        if (queueCount < WORK_QUEUE_SIZE) {
+          int tail = (queueHead + queueCount) % WORK_QUEUE_SIZE;
+          dwp_copy(&workQueue[tail], &reqPacket);
+          queueCount++;
+          pthread_cond_signal(&cond);
+        }
+        else {
+          LOG_WARN("## Work queue is full.");
+        }
         pthread_mutex_unlock(&mutex);
         dwp_destroy(&reqPacket);
         break;
       case DWP_TYPE_STOP: // 수신한 패킷이 중단 요청인 경우
-        printf(">> The stop request is received\n");
+        TRACE_PROBE1(stop, serverSd);
+        LOG_INFO(">> The stop request is received");
         terminateFindNonce = true;
         terminateFindNonceThread();
         break;
       default:
-        fprintf(stderr, "## Invalid packet type.\n");
+        LOG_WARN("## Invalid packet type.");
         break;
     }
 
@@ -191,11 +318,13 @@ void* findNonceThread(void* arg)
 {
   SOCKET serverSd = *(SOCKET*)arg;
   dwp_packet reqPacket, resPacket;
+  memset(&reqPacket, 0, sizeof(reqPacket));
+  memset(&resPacket, 0, sizeof(resPacket));
   while (true) {
     pthread_mutex_lock(&mutex);
 
     // 작업 요청이나 중단 요청이 올 때까지 대기
-    while (!isFinished && !isWorkRequested) {
+    while (!isFinished && queueCount == 0) {
       pthread_cond_wait(&cond, &mutex);
     }
 
@@ -205,13 +334,47 @@ void* findNonceThread(void* arg)
       break;
     }
 
-    // 작업 요청이 온 경우 findNonce 함수 실행
-    isWorkRequested = false;
+    // 큐의 가장 오래된 작업 요청을 꺼내 findNonce 함수 실행
     memset(&reqPacket, 0, sizeof(reqPacket));
-    dwp_copy(&reqPacket, &packet);
-    dwp_destroy(&packet);
+    dwp_copy(&reqPacket, &workQueue[queueHead]);
+    dwp_destroy(&workQueue[queueHead]);
+    queueHead = (queueHead + 1) % WORK_QUEUE_SIZE;
+    queueCount--;
     pthread_mutex_unlock(&mutex);
 
+    // 작업 옵션을 읽고, 챌린지를 해시 상태에 미리 반영해 둔다.
+    dwp_job_option option;
+    pow_context context;
+    memset(&option, 0, sizeof(option));
+    dwp_get_ext(&reqPacket, &option, sizeof(option));
+    if (makeContext(&reqPacket, &option, &context) != 0) {
+      // 탐색하지 못한 범위는 메인서버가 다른 작업서버에 분배하도록 돌려준다.
+      LOG_WARN("## Unsupported hash algorithm: %u", option.hashAlgorithm);
+      sendRangeRejected(serverSd, reqPacket.nonce, reqPacket.workload);
+      dwp_destroy(&reqPacket);
+      continue;
+    }
+
+    // 분할 모드 작업인 경우 자신의 구간을 스스로 순회한다.
+    if (option.shardCount > 0) {
+      runShardJob(serverSd, &reqPacket, &option, &context);
+      dwp_destroy(&reqPacket);
+      continue;
+    }
+
+    // 모든 정답/상위 k개 탐색 모드인 경우 범위의 정답을 모두 보고한 뒤 범위 완료(실패 응답)를 알린다.
+    if (reqPacket.data.type == DWP_TYPE_EXT && option.searchMode != DWP_MODE_FIRST) {
+      int res = collectNonces(&reqPacket, &option, &context, reqPacket.nonce, reqPacket.workload);
+      if (res == POW_ERROR) {
+        sendRangeRejected(serverSd, reqPacket.nonce, reqPacket.workload);
+      }
+      else if (res != POW_TERMINATED) {
+        sendRangeDone(serverSd, reqPacket.nonce, reqPacket.workload);
+      }
+      dwp_destroy(&reqPacket);
+      continue;
+    }
+
     unsigned int resultNonce;   // 결과 nonce
     char sha256Hash[65];        // 챌린지와 결과 nonce에 해당하는 해시 값
 
@@ -220,26 +383,30 @@ void* findNonceThread(void* arg)
     unsigned int workload = reqPacket.workload;     // 작업량
     char* challenge = strdup(reqPacket.challenge);  // 챌린지
 
-    printf(">> Start to find nonce in range: [%d..%d)\n", startNonce, startNonce + workload);
+    LOG_DEBUG(">> Start to find nonce in range: [%d..%d)", startNonce, startNonce + workload);
 
-    // nonce 값을 찾는다.
-    int res = findNonce(&resultNonce, sha256Hash, challenge, difficulty, startNonce, workload);
+    // 해시 스레드들이 범위를 나누어 nonce 값을 찾는다.
+    TRACE_PROBE2(range_start, startNonce, workload);
+    int res = searchRange(&option, &context, difficulty, startNonce, workload, &resultNonce, sha256Hash);
+    endRange(startNonce, workload, res, res == POW_NOTFOUND);
 
-    printf(">> End to find nonce\n");
+    LOG_DEBUG(">> End to find nonce");
 
     switch (res) {
       case POW_NOTFOUND:  // 난이도 조건을 만족하는 nonce 값이 없는 경우
-        dwp_send(serverSd, DWP_QR_RESPONSE, DWP_TYPE_FAIL, NULL);
-        printf(">> Failure response is sent\n");
+        sendRangeDone(serverSd, startNonce, workload);
+        LOG_DEBUG(">> Failure response is sent");
         break;
       case POW_SUCCESS: // nonce 값을 찾은 경우
+        TRACE_PROBE1(hit, resultNonce);
         memset(&resPacket, 0, sizeof(resPacket));
         dwp_create_res(difficulty, resultNonce, workload, challenge, strlen(challenge), &resPacket);
         dwp_send(serverSd, DWP_QR_RESPONSE, DWP_TYPE_SUCCESS, &resPacket);
-        printf(">> Success response is sent\n");
+        dwp_destroy(&resPacket);
+        LOG_INFO(">> Success response is sent");
         break;
       case POW_TERMINATED:  // findNonce가 중단된 경우
-        printf(">> findNonce is terminated\n");
+        LOG_INFO(">> findNonce is terminated");
         break;
       default:
         break;
@@ -251,4 +418,419 @@ void* findNonceThread(void* arg)
 
   dwp_destroy(&reqPacket);
   dwp_destroy(&resPacket);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 작업 요청의 챌린지를 해시 상태에 반영하는 함수이다.
+ * 메인서버가 챌린지 앞부분의 중간 상태(midstate)를 보낸 경우 바디에는 나머지 꼬리만 담겨 있으므로,
+ * 중간 상태에서 이어서 꼬리만 해시한다. 따라서 nonce마다 챌린지 앞부분을 다시 해시하지 않는다.
+ * 
+ * @param reqPacket 작업 요청 패킷
+ * @param option 작업 옵션
+ * @param context 초기화할 해시 상태
+ * @return int 성공 시 0, 지원하지 않는 해시 알고리즘이면 -1
+ */
+int makeContext(const dwp_packet* reqPacket, const dwp_job_option* option, pow_context* context)
+{
+  if (option->prefixLength > 0) {
+    return pow_context_resume(context, option->hashAlgorithm, option->midstate, option->prefixLength,
+      reqPacket->challenge, reqPacket->data.bodylen);
+  }
+  return pow_context_init(context, option->hashAlgorithm, reqPacket->challenge, reqPacket->data.bodylen);
+}
+
+/**
+ * @brief 범위 탐색이 끝났을 때 트레이스포인트를 남기고, 성능 카운터를 켠 경우 해시당 측정값을 출력하는 함수이다.
+ * 중간에 멈춘 범위는 실제 해시 수를 알 수 없으므로 측정값을 출력하지 않는다.
+ * 
+ * @param startNonce 범위의 시작 nonce
+ * @param workload 범위의 크기
+ * @param res 탐색 결과 (POW_*)
+ * @param isComplete 범위 전체를 탐색했는지 여부
+ */
+void endRange(unsigned int startNonce, unsigned int workload, int res, bool isComplete)
+{
+  perf_sample sample;
+  TRACE_PROBE3(range_end, startNonce, workload, res);
+  if (!usePerfCounters || !isComplete || workload == 0 || !hash_pool_sample(&sample)) {
+    return;
+  }
+  LOG_INFO(">> perf [%u..%llu): %.1f cycles/hash, IPC %.2f, %.4f branch misses/hash", startNonce,
+    (unsigned long long)startNonce + workload, (double)sample.cycles / workload,
+    sample.cycles > 0 ? (double)sample.instructions / sample.cycles : 0.0, (double)sample.branchMisses / workload);
+}
+
+/**
+ * @brief 첫 정답 모드에서 범위 하나를 탐색하는 함수이다.
+ * 작업 옵션에 share 난이도가 있으면 share를 모아 DWP_SHARE_BATCH개씩 보고하며, 범위가 끝나면 남은 share가
+ * 모두 전송될 때까지 기다려 결과 응답보다 먼저 도착하게 한다. 메인서버는 share를 검증하여 작업서버의 실제 해시 속도를 추정한다.
+ * 
+ * @param option 작업 옵션
+ * @param context 챌린지를 반영한 해시 상태
+ * @param difficulty 난이도
+ * @param startNonce 시작 nonce
+ * @param workload 작업량
+ * @param nonce 찾은 nonce
+ * @param hashresult 찾은 nonce의 해시값
+ * @return int findNonce와 같다
+ */
+int searchRange(const dwp_job_option* option, const pow_context* context, int difficulty,
+  unsigned int startNonce, unsigned int workload, unsigned int* nonce, char hashresult[65])
+{
+  // 메인서버가 하한보다 낮은 share 난이도를 보내더라도 하한으로 올려 탐색한다.
+  int shareDifficulty = option->shareDifficulty < DWP_SHARE_DIFFICULTY_MIN ? DWP_SHARE_DIFFICULTY_MIN : (int)option->shareDifficulty;
+  if (option->shareDifficulty == 0 || shareDifficulty >= difficulty) {
+    return hash_pool_find(nonce, hashresult, context, difficulty, startNonce, workload);
+  }
+
+  ShareCollector collector;
+  collector.startNonce = startNonce;
+  collector.workload = workload;
+  collector.count = 0;
+  int res = hash_pool_find_shares(nonce, hashresult, context, difficulty, shareDifficulty, startNonce, workload, onShareFound, &collector);
+  if (res != POW_TERMINATED) {
+    flushShares(&collector);
+    waitReportsSent();
+  }
+  return res;
+}
+
+/**
+ * @brief 모아 둔 share를 share 보고 패킷으로 만들어 전송 큐에 넣는 함수이다.
+ * 
+ * @param collector share를 모아 둔 구조체
+ */
+void flushShares(ShareCollector* collector)
+{
+  dwp_packet resPacket;
+
+  if (collector->count == 0) {
+    return;
+  }
+  dwp_create_ext(DWP_QR_RESPONSE, DWP_EXT_SHARES, collector->startNonce, collector->workload, collector->nonces,
+    collector->count * sizeof(unsigned int), &resPacket);
+  resPacket.ext.count = collector->count;
+  queueReport(&resPacket);
+  collector->count = 0;
+}
+
+/**
+ * @brief share 탐색에서 share를 찾을 때마다 호출되어 share를 모으는 함수이다. 버퍼가 차면 전송 큐에 넣는다.
+ */
+void onShareFound(unsigned int nonce, const char hash[65], void* arg)
+{
+  (void)hash; // share는 nonce만 보고하며, 메인서버가 해시를 다시 계산하여 검증한다
+  ShareCollector* collector = (ShareCollector*)arg;
+  collector->nonces[collector->count++] = nonce;
+  if (collector->count == DWP_SHARE_BATCH) {
+    flushShares(collector);
+  }
+}
+
+/**
+ * @brief 탐색을 마친 범위를 담아 실패 응답을 보내는 함수이다.
+ * 메인서버는 응답의 범위로 완료된 범위를 체크포인트에 기록한다.
+ * 
+ * @param serverSd 메인서버의 소켓
+ * @param startNonce 완료한 범위의 시작 nonce
+ * @param workload 완료한 범위의 크기
+ */
+void sendRangeDone(SOCKET serverSd, unsigned int startNonce, unsigned int workload)
+{
+  dwp_packet failPacket;
+  dwp_create_stop(DWP_QR_RESPONSE, &failPacket);
+  failPacket.nonce = startNonce;
+  failPacket.workload = workload;
+  dwp_send(serverSd, DWP_QR_RESPONSE, DWP_TYPE_FAIL, &failPacket);
+}
+
+/**
+ * @brief 탐색하지 못한 범위를 돌려주는 응답을 보내는 함수이다.
+ * 메인서버는 돌려받은 범위를 완료로 기록하지 않고 다른 작업서버에 다시 분배한다.
+ * 
+ * @param serverSd 메인서버의 소켓
+ * @param startNonce 돌려줄 범위의 시작 nonce
+ * @param workload 돌려줄 범위의 크기
+ */
+void sendRangeRejected(SOCKET serverSd, unsigned int startNonce, unsigned int workload)
+{
+  dwp_packet resPacket;
+  dwp_create_ext(DWP_QR_RESPONSE, DWP_EXT_REJECT, startNonce, workload, NULL, 0, &resPacket);
+  dwp_send(serverSd, DWP_QR_RESPONSE, DWP_TYPE_EXT, &resPacket);
+  dwp_destroy(&resPacket);
+}
+
+/**
+ * @brief 분할 모드에서 자신에게 배정된 nonce 구간을 순회하는 함수이다.
+ * 
+ * nonce 공간을 workload 크기의 청크로 나누고, shardIndex번째 청크부터 shardCount개씩 건너뛰며
+ * 탐색한다. 메인서버와의 추가 작업 할당 없이 정답과 주기적인 진행 상황만 보고한다.
+ * 구간을 모두 탐색한 경우 실패 응답을 보낸다.
+ * 
+ * @param serverSd 메인서버의 소켓
+ * @param reqPacket 분할 작업 요청 패킷
+ * @param option 분할 작업 옵션
+ * @param context 챌린지를 반영한 해시 상태
+ */
+void runShardJob(SOCKET serverSd, const dwp_packet* reqPacket, const dwp_job_option* option, const pow_context* context)
+{
+  int difficulty = reqPacket->data.difficulty;
+  unsigned int workload = reqPacket->workload;
+  unsigned long long stride = (unsigned long long)workload * option->shardCount;
+  unsigned long long startNonce = reqPacket->nonce + (unsigned long long)workload * option->shardIndex;
+  unsigned int reported = 0;  // 지난 보고 이후 탐색한 청크 수
+  unsigned int resultNonce;
+  char sha256Hash[65];
+  dwp_packet resPacket;
+
+  LOG_INFO(">> Start shard %u/%u", option->shardIndex, option->shardCount);
+
+  // 탐색 종료 nonce가 없으면 nonce 공간 끝까지 탐색한다.
+  unsigned long long searchEnd = option->searchEnd > 0 ? option->searchEnd : 0x100000000ULL;
+
+  for (; startNonce < searchEnd; startNonce += stride) {
+    unsigned int range = startNonce + workload <= searchEnd ? workload : searchEnd - startNonce;
+    int res;
+
+    // 모든 정답/상위 k개 탐색 모드는 정답을 찾아도 멈추지 않는다.
+    if (option->searchMode != DWP_MODE_FIRST) {
+      res = collectNonces(reqPacket, option, context, startNonce, range);
+      if (res == POW_TERMINATED) {
+        LOG_INFO(">> findNonce is terminated");
+        return;
+      }
+      if (res == POW_ERROR) {
+        sendRangeRejected(serverSd, startNonce, range);
+        return;
+      }
+    }
+    else {
+      TRACE_PROBE2(range_start, startNonce, range);
+      res = searchRange(option, context, difficulty, startNonce, range, &resultNonce, sha256Hash);
+      endRange(startNonce, range, res, res == POW_NOTFOUND);
+      if (res == POW_TERMINATED) {
+        LOG_INFO(">> findNonce is terminated");
+        return;
+      }
+      if (res == POW_SUCCESS) {
+        TRACE_PROBE1(hit, resultNonce);
+        dwp_create_res(difficulty, resultNonce, workload, reqPacket->challenge, strlen(reqPacket->challenge), &resPacket);
+        dwp_send(serverSd, DWP_QR_RESPONSE, DWP_TYPE_SUCCESS, &resPacket);
+        dwp_destroy(&resPacket);
+        LOG_INFO(">> Success response is sent");
+        return;
+      }
+    }
+
+    // 주기적으로 다음 탐색 nonce와 탐색한 nonce 수를 보고한다.
+    if (option->progressInterval > 0 && ++reported >= option->progressInterval) {
+      dwp_create_ext(DWP_QR_RESPONSE, DWP_EXT_PROGRESS, startNonce + stride, reported * workload, NULL, 0, &resPacket);
+      dwp_send(serverSd, DWP_QR_RESPONSE, DWP_TYPE_EXT, &resPacket);
+      dwp_destroy(&resPacket);
+      reported = 0;
+    }
+  }
+
+  dwp_send(serverSd, DWP_QR_RESPONSE, DWP_TYPE_FAIL, NULL);
+  LOG_INFO(">> Shard is exhausted");
+}
+
+/**
+ * @brief 모아 둔 정답을 DWP_RESULT_BATCH개씩 묶어 결과 보고 패킷으로 만들어 전송 큐에 넣는 함수이다.
+ * 
+ * @param collector 정답을 모아 둔 구조체
+ */
+void flushResults(ResultCollector* collector)
+{
+  dwp_packet resPacket;
+
+  for (int i = 0; i < collector->count; i += DWP_RESULT_BATCH) {
+    int count = collector->count - i < DWP_RESULT_BATCH ? collector->count - i : DWP_RESULT_BATCH;
+    dwp_create_ext(DWP_QR_RESPONSE, DWP_EXT_RESULTS, 0, 0, &collector->results[i], count * sizeof(dwp_result), &resPacket);
+    resPacket.ext.count = count;
+    queueReport(&resPacket);
+  }
+  collector->count = 0;
+}
+
+/**
+ * @brief findAllNonces에서 정답을 찾을 때마다 호출되어 정답을 모으는 함수이다.
+ * 모든 정답 모드에서는 버퍼가 차면 전송 큐에 넣고, 상위 k개 모드에서는 해시값 순으로 정렬된 k개만 유지한다.
+ */
+void onNonceFound(unsigned int nonce, const char hash[65], void* arg)
+{
+  ResultCollector* collector = (ResultCollector*)arg;
+  dwp_result result;
+  TRACE_PROBE1(hit, nonce);
+  result.nonce = nonce;
+  memcpy(result.hash, hash, sizeof(result.hash));
+
+  if (collector->option->searchMode == DWP_MODE_ALL) {
+    collector->results[collector->count++] = result;
+    if (collector->count == collector->capacity) {
+      flushResults(collector);
+    }
+    return;
+  }
+
+  // 상위 k개 모드: 정렬된 배열에 삽입한다.
+  if (collector->count == collector->capacity) {
+    if (dwp_compare_result(&result, &collector->results[collector->count - 1]) >= 0) {
+      return;
+    }
+    collector->count--;
+  }
+  int pos = collector->count;
+  while (pos > 0 && dwp_compare_result(&result, &collector->results[pos - 1]) < 0) {
+    collector->results[pos] = collector->results[pos - 1];
+    pos--;
+  }
+  collector->results[pos] = result;
+  collector->count++;
+}
+
+/**
+ * @brief 주어진 범위에서 난이도를 만족하는 정답을 모두 찾아 메인서버에 보고하는 함수이다.
+ * 
+ * @param reqPacket 작업 요청 패킷
+ * @param option 작업 옵션
+ * @param context 챌린지를 반영한 해시 상태
+ * @param startNonce 시작 nonce
+ * @param workload 작업량
+ * @return int findAllNonces의 실행 결과. 수집할 정답 수가 잘못되었거나 메모리가 부족하면 탐색하지 않고 POW_ERROR
+ */
+int collectNonces(const dwp_packet* reqPacket, const dwp_job_option* option, const pow_context* context, unsigned int startNonce, unsigned int workload)
+{
+  ResultCollector collector;
+  collector.option = option;
+  collector.count = 0;
+  if (option->searchMode == DWP_MODE_TOPK && (option->resultLimit == 0 || option->resultLimit > DWP_RESULT_LIMIT_MAX)) {
+    LOG_WARN("## Invalid result limit: %u", option->resultLimit);
+    return POW_ERROR;
+  }
+  collector.capacity = option->searchMode == DWP_MODE_TOPK ? (int)option->resultLimit : DWP_RESULT_BATCH;
+  collector.results = (dwp_result*)malloc(collector.capacity * sizeof(dwp_result));
+  if (collector.results == NULL) {
+    LOG_WARN("## Failed to allocate %d results.", collector.capacity);
+    return POW_ERROR;
+  }
+
+  LOG_DEBUG(">> Start to collect nonces in range: [%u..%u)", startNonce, startNonce + workload);
+  TRACE_PROBE2(range_start, startNonce, workload);
+  int res = hash_pool_find_all(context, reqPacket->data.difficulty, startNonce, workload, onNonceFound, &collector);
+  endRange(startNonce, workload, res, res != POW_TERMINATED);
+  if (res != POW_TERMINATED) {
+    flushResults(&collector);
+    waitReportsSent();
+  }
+
+  free(collector.results);
+  return res;
+}
+
+/**
+ * @brief 보고 전송 큐의 패킷을 차례로 메인서버에 보내는 스레드 함수이다.
+ * 전송 중에는 큐의 뮤텍스를 놓으므로, 해시 스레드는 소켓 버퍼가 가득 차도 기다리지 않고 보고를 쌓는다.
+ * 
+ * @param arg 메인서버의 소켓 포인터
+ */
+void* reportThread(void* arg)
+{
+  SOCKET serverSd = *(SOCKET*)arg;
+
+  pthread_mutex_lock(&reportMutex);
+  while (true) {
+    while (!isReportShutdown && reportHead == NULL) {
+      pthread_cond_wait(&reportCond, &reportMutex);
+    }
+    if (isReportShutdown) {
+      break;
+    }
+    Report* report = reportHead;
+    reportHead = report->next;
+    if (reportHead == NULL) {
+      reportTail = NULL;
+    }
+    reportCount--;
+    isReportSending = true;
+    pthread_mutex_unlock(&reportMutex);
+
+    dwp_send(serverSd, DWP_QR_RESPONSE, DWP_TYPE_EXT, &report->packet);
+    dwp_destroy(&report->packet);
+    free(report);
+
+    pthread_mutex_lock(&reportMutex);
+    isReportSending = false;
+    pthread_cond_broadcast(&reportCond);
+  }
+
+  // 종료할 때 보내지 못한 보고는 버린다.
+  while (reportHead != NULL) {
+    Report* report = reportHead;
+    reportHead = report->next;
+    dwp_destroy(&report->packet);
+    free(report);
+  }
+  reportTail = NULL;
+  reportCount = 0;
+  if (droppedShareReports > 0) {
+    LOG_WARN("## %llu share reports were dropped.", droppedShareReports);
+  }
+  pthread_mutex_unlock(&reportMutex);
+  return NULL;
+}
+
+/**
+ * @brief 보고 패킷을 전송 큐에 넣는 함수이다. 패킷의 확장 바디는 전송 스레드가 보낸 뒤 해제한다.
+ * 큐가 가득 차면 share 보고는 해시 속도 추정에만 쓰이므로 버리고, 결과 보고는 전송 스레드가 자리를 비울 때까지 기다린다.
+ * 
+ * @param packet 보낼 확장 응답 패킷
+ */
+void queueReport(dwp_packet* packet)
+{
+  pthread_mutex_lock(&reportMutex);
+  while (reportCount >= REPORT_QUEUE_SIZE && !isReportShutdown && packet->ext.kind != DWP_EXT_SHARES) {
+    pthread_cond_wait(&reportCond, &reportMutex);
+  }
+  if (reportCount >= REPORT_QUEUE_SIZE || isReportShutdown) {
+    if (packet->ext.kind == DWP_EXT_SHARES) {
+      droppedShareReports++;
+    }
+    pthread_mutex_unlock(&reportMutex);
+    dwp_destroy(packet);
+    return;
+  }
+
+  Report* report = (Report*)malloc(sizeof(Report));
+  if (report == NULL) {
+    pthread_mutex_unlock(&reportMutex);
+    LOG_WARN("## Failed to queue a report.");
+    dwp_destroy(packet);
+    return;
+  }
+  report->packet = *packet;
+  report->next = NULL;
+  reportCount++;
+  if (reportTail != NULL) {
+    reportTail->next = report;
+  }
+  else {
+    reportHead = report;
+  }
+  reportTail = report;
+  pthread_cond_broadcast(&reportCond);
+  pthread_mutex_unlock(&reportMutex);
+}
+
+/**
+ * @brief 전송 큐에 넣은 보고가 모두 전송될 때까지 기다리는 함수이다.
+ * 범위 완료나 정답 응답을 보내기 전에 호출하여, 메인서버가 그 범위의 보고를 먼저 받게 한다.
+ */
+void waitReportsSent()
+{
+  pthread_mutex_lock(&reportMutex);
+  while (!isReportShutdown && (reportHead != NULL || isReportSending)) {
+    pthread_cond_wait(&reportCond, &reportMutex);
+  }
+  pthread_mutex_unlock(&reportMutex);
+}